@@ -0,0 +1,62 @@
+#include "frame_scheduler.h"
+#include "laser_tag_arena.h"
+
+struct FrameScheduler {
+    FuriTimer* timer;
+    uint32_t interval;
+    uint32_t last_frame;
+    bool pending;
+    FrameSchedulerCallback callback;
+    void* callback_context;
+};
+
+static void frame_scheduler_timer_callback(void* context) {
+    FrameScheduler* scheduler = context;
+    scheduler->callback(scheduler->callback_context);
+}
+
+FrameScheduler*
+    frame_scheduler_alloc(uint32_t max_fps, FrameSchedulerCallback callback, void* context) {
+    furi_assert(max_fps > 0);
+    furi_assert(callback);
+
+    FrameScheduler* scheduler = laser_tag_arena_alloc(sizeof(FrameScheduler));
+    if(!scheduler) return NULL;
+    scheduler->interval = furi_kernel_get_tick_frequency() / max_fps;
+    scheduler->last_frame = furi_get_tick() - scheduler->interval;
+    scheduler->pending = false;
+    scheduler->callback = callback;
+    scheduler->callback_context = context;
+    scheduler->timer = furi_timer_alloc(frame_scheduler_timer_callback, FuriTimerTypeOnce, scheduler);
+
+    return scheduler;
+}
+
+void frame_scheduler_free(FrameScheduler* scheduler) {
+    furi_assert(scheduler);
+    furi_timer_stop(scheduler->timer);
+    furi_timer_free(scheduler->timer);
+}
+
+void frame_scheduler_request(FrameScheduler* scheduler) {
+    furi_assert(scheduler);
+    scheduler->pending = true;
+}
+
+bool frame_scheduler_commit(FrameScheduler* scheduler) {
+    furi_assert(scheduler);
+    if(!scheduler->pending) return false;
+
+    uint32_t now = furi_get_tick();
+    uint32_t elapsed = now - scheduler->last_frame;
+    if(elapsed >= scheduler->interval) {
+        scheduler->pending = false;
+        scheduler->last_frame = now;
+        return true;
+    }
+
+    if(!furi_timer_is_running(scheduler->timer)) {
+        furi_timer_start(scheduler->timer, scheduler->interval - elapsed);
+    }
+    return false;
+}
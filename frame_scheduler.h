@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+* @file frame_scheduler.h
+* @brief Coalescing redraw scheduler.
+* @details Any number of redraw requests between two frames collapse into one frame, and frames
+* are never taken more often than the configured rate. A request that arrives too early arms a
+* one-shot timer whose callback lets the owner come back and take the deferred frame.
+*/
+
+#include <furi.h>
+
+typedef struct FrameScheduler FrameScheduler;
+
+/**
+ * @brief Called from the timer thread when a deferred frame becomes due.
+ * @param context Callback context.
+ */
+typedef void (*FrameSchedulerCallback)(void* context);
+
+/**
+ * @brief Allocates a new FrameScheduler.
+ * @param max_fps Maximum number of frames per second.
+ * @param callback Callback for deferred frames.
+ * @param context Callback context.
+ * @return FrameScheduler* Pointer to the allocated FrameScheduler.
+ */
+FrameScheduler*
+    frame_scheduler_alloc(uint32_t max_fps, FrameSchedulerCallback callback, void* context);
+
+/**
+ * @brief Frees the FrameScheduler.
+ * @param scheduler FrameScheduler to free.
+ */
+void frame_scheduler_free(FrameScheduler* scheduler);
+
+/**
+ * @brief Marks the screen as changed; merged with every other request until the next frame.
+ * @param scheduler FrameScheduler to request a frame from.
+ */
+void frame_scheduler_request(FrameScheduler* scheduler);
+
+/**
+ * @brief Decides whether a frame should be drawn now.
+ * @details Returns true at most once per frame interval and only if something was requested.
+ * If a frame is pending but too early, the deferred frame callback is armed instead.
+ * @param scheduler FrameScheduler to query.
+ * @return true if the caller should draw a frame now.
+ */
+bool frame_scheduler_commit(FrameScheduler* scheduler);
@@ -1,75 +1,174 @@
 #include "game_state.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
 #include <furi.h>
 #include <stdlib.h>
 
+#define GAME_STATE_MAX_HEALTH_Q8 ((uint32_t)MAX_HEALTH * GAME_STATE_Q8_ONE)
+#define GAME_STATE_MAX_SHIELD_Q8 ((uint32_t)MAX_SHIELD * GAME_STATE_Q8_ONE)
+
 struct GameState {
-    uint8_t health;
+    // Health and shield are kept in Q8.8 so multipliers and regen never lose fractions.
+    uint16_t health_q8;
+    uint16_t shield_q8;
+    GameStateQ8 regen_per_second;
+    uint32_t regen_remainder; /**< Regen carried over, in thousandths of a Q8 unit. */
     uint16_t ammo;
-    uint32_t game_time;
+    uint32_t game_time_ms;
     bool game_over;
+    uint32_t invulnerable_until;
+    bool invulnerable;
+    int16_t last_hit_by;
+    uint32_t hits_taken;
 };
 
+static inline uint32_t game_state_min(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+// Whole hit points as shown to the player; any fraction left still counts as one.
+static inline uint8_t game_state_to_points(uint32_t value_q8) {
+    return (value_q8 + GAME_STATE_Q8_ONE - 1) >> 8;
+}
+
+static void game_state_heal(GameState* state, uint32_t amount_q8) {
+    state->health_q8 = game_state_min(state->health_q8 + amount_q8, GAME_STATE_MAX_HEALTH_Q8);
+}
+
+static void game_state_damage(GameState* state, uint32_t amount_q8) {
+    // The shield soaks up damage before health does.
+    uint32_t absorbed = game_state_min(amount_q8, state->shield_q8);
+    state->shield_q8 -= absorbed;
+    amount_q8 -= absorbed;
+    state->health_q8 -= game_state_min(amount_q8, state->health_q8);
+    state->game_over |= state->health_q8 == 0;
+}
+
+typedef struct {
+    uint8_t health;
+    uint8_t shield;
+    uint16_t ammo;
+    uint32_t seconds;
+    bool game_over;
+    int16_t last_hit_by;
+} GameStateSnapshot;
+
+static void game_state_snapshot(GameState* state, GameStateSnapshot* snapshot) {
+    snapshot->health = game_state_to_points(state->health_q8);
+    snapshot->shield = game_state_to_points(state->shield_q8);
+    snapshot->ammo = state->ammo;
+    snapshot->seconds = state->game_time_ms / 1000;
+    snapshot->game_over = state->game_over;
+    snapshot->last_hit_by = state->last_hit_by;
+}
+
 GameState* game_state_alloc() {
-    GameState* state = malloc(sizeof(GameState));
+    GameState* state = laser_tag_arena_alloc(sizeof(GameState));
     if(!state) {
         FURI_LOG_E("GameState", "Failed to allocate GameState");
         return NULL;
     }
-    state->health = INITIAL_HEALTH;
-    state->ammo = INITIAL_AMMO;
-    state->game_time = 0;
-    state->game_over = false;
-    FURI_LOG_I("GameState", "GameState allocated successfully");
+    state->invulnerable_until = 0;
+    game_state_reset(state);
+    LASER_TAG_LOG_I("GameState", "GameState allocated successfully");
     return state;
 }
 
 void game_state_reset(GameState* state) {
     furi_assert(state);
-    state->health = INITIAL_HEALTH;
+    state->health_q8 = (uint32_t)INITIAL_HEALTH * GAME_STATE_Q8_ONE;
+    state->shield_q8 = 0;
     state->ammo = INITIAL_AMMO;
-    state->game_time = 0;
+    state->game_time_ms = 0;
+    state->regen_per_second = 0;
+    state->regen_remainder = 0;
     state->game_over = false;
-    FURI_LOG_I("GameState", "GameState reset");
+    state->invulnerable = false;
+    state->last_hit_by = GAME_STATE_NO_PLAYER;
+    state->hits_taken = 0;
+    LASER_TAG_LOG_I("GameState", "GameState reset");
 }
 
-void game_state_decrease_health(GameState* state, uint8_t amount) {
+uint32_t game_state_apply(GameState* state, const GameStateUpdate* update) {
     furi_assert(state);
-    if(state->health > amount) {
-        state->health -= amount;
-    } else {
-        state->health = 0;
-        state->game_over = true;
+    furi_assert(update);
+    furi_assert(update->hits || update->hit_count == 0);
+
+    GameStateSnapshot before, after;
+    game_state_snapshot(state, &before);
+
+    // Time and regen first, then pickups, then damage, so a pickup read in the same
+    // batch as a finishing shot can still save the player.
+    state->game_time_ms += update->elapsed_ms;
+    if(!state->game_over) {
+        // Regen is per second but time comes in milliseconds; carry what does not divide.
+        uint64_t regen =
+            (uint64_t)update->elapsed_ms * state->regen_per_second + state->regen_remainder;
+        state->regen_remainder = regen % 1000;
+        uint64_t heal_q8 = regen / 1000;
+        game_state_heal(
+            state, heal_q8 < GAME_STATE_MAX_HEALTH_Q8 ? heal_q8 : GAME_STATE_MAX_HEALTH_Q8);
+        game_state_heal(state, (uint32_t)update->health_gained * GAME_STATE_Q8_ONE);
+        state->shield_q8 = game_state_min(
+            state->shield_q8 + (uint32_t)update->shield_gained * GAME_STATE_Q8_ONE,
+            GAME_STATE_MAX_SHIELD_Q8);
+    }
+
+    for(size_t i = 0; i < update->hit_count && !state->game_over; i++) {
+        const GameStateHit* hit = &update->hits[i];
+        if(game_state_is_invulnerable(state, hit->tick)) continue;
+        game_state_damage(state, (uint32_t)hit->damage * hit->multiplier);
+        state->last_hit_by = hit->player_id;
+        state->hits_taken++;
+        game_state_start_invulnerability(state, hit->tick);
+    }
+
+    uint32_t ammo = state->ammo + update->ammo_gained;
+    state->ammo = ammo - game_state_min(ammo, update->ammo_used);
+
+    // Compare what the player sees, not the raw Q8.8 values, so fractional regen does not
+    // trigger a redraw every tick.
+    game_state_snapshot(state, &after);
+    uint32_t changed = 0;
+    changed |= (after.health != before.health) ? GameStateFieldHealth : 0;
+    changed |= (after.shield != before.shield) ? GameStateFieldShield : 0;
+    changed |= (after.ammo != before.ammo) ? GameStateFieldAmmo : 0;
+    changed |= (after.seconds != before.seconds) ? GameStateFieldTime : 0;
+    changed |= (after.game_over != before.game_over) ? GameStateFieldGameOver : 0;
+    changed |= (after.last_hit_by != before.last_hit_by) ? GameStateFieldLastHitBy : 0;
+
+    if(changed & GameStateFieldGameOver) {
         FURI_LOG_W("GameState", "Health depleted, game over");
     }
-    FURI_LOG_I("GameState", "Health decreased to %d", state->health);
+    LASER_TAG_LOG_I(
+        "GameState",
+        "Update applied: health %d shield %d ammo %d, changed %02lx",
+        after.health,
+        after.shield,
+        after.ammo,
+        (unsigned long)changed);
+    return changed;
 }
 
-void game_state_increase_health(GameState* state, uint8_t amount) {
+void game_state_set_regen(GameState* state, GameStateQ8 per_second) {
     furi_assert(state);
-    state->health = (state->health + amount > MAX_HEALTH) ? MAX_HEALTH : state->health + amount;
-    FURI_LOG_I("GameState", "Health increased to %d", state->health);
+    state->regen_per_second = per_second;
+    LASER_TAG_LOG_I("GameState", "Regen set to %d/256 HP per second", per_second);
 }
 
-uint8_t game_state_get_health(GameState* state) {
+GameStateQ8 game_state_get_regen(GameState* state) {
     furi_assert(state);
-    return state->health;
+    return state->regen_per_second;
 }
 
-void game_state_decrease_ammo(GameState* state, uint16_t amount) {
+uint8_t game_state_get_health(GameState* state) {
     furi_assert(state);
-    if(state->ammo > amount) {
-        state->ammo -= amount;
-    } else {
-        state->ammo = 0;
-        FURI_LOG_W("GameState", "Ammo depleted");
-    }
-    FURI_LOG_I("GameState", "Ammo decreased to %d", state->ammo);
+    return game_state_to_points(state->health_q8);
 }
 
-void game_state_increase_ammo(GameState* state, uint16_t amount) {
+uint8_t game_state_get_shield(GameState* state) {
     furi_assert(state);
-    state->ammo += amount;
-    FURI_LOG_I("GameState", "Ammo increased to %d", state->ammo);
+    return game_state_to_points(state->shield_q8);
 }
 
 uint16_t game_state_get_ammo(GameState* state) {
@@ -77,15 +176,45 @@ uint16_t game_state_get_ammo(GameState* state) {
     return state->ammo;
 }
 
-void game_state_update_time(GameState* state, uint32_t delta_time) {
+int16_t game_state_get_last_hit_by(GameState* state) {
     furi_assert(state);
-    state->game_time += delta_time;
-    FURI_LOG_I("GameState", "Game time updated to %ld seconds", state->game_time);
+    return state->last_hit_by;
+}
+
+uint32_t game_state_get_hits_taken(GameState* state) {
+    furi_assert(state);
+    return state->hits_taken;
 }
 
 uint32_t game_state_get_time(GameState* state) {
     furi_assert(state);
-    return state->game_time;
+    return state->game_time_ms / 1000;
+}
+
+uint32_t game_state_get_time_ms(GameState* state) {
+    furi_assert(state);
+    return state->game_time_ms;
+}
+
+void game_state_set_time_ms(GameState* state, uint32_t time_ms) {
+    furi_assert(state);
+    state->game_time_ms = time_ms;
+    LASER_TAG_LOG_I("GameState", "Game time set to %lu ms", (unsigned long)time_ms);
+}
+
+void game_state_start_invulnerability(GameState* state, uint32_t now) {
+    furi_assert(state);
+    state->invulnerable = HIT_INVULNERABILITY_MS > 0;
+    state->invulnerable_until = now + furi_ms_to_ticks(HIT_INVULNERABILITY_MS);
+}
+
+bool game_state_is_invulnerable(GameState* state, uint32_t now) {
+    furi_assert(state);
+    // Signed difference keeps the comparison correct across tick wrap-around.
+    if(state->invulnerable && (int32_t)(now - state->invulnerable_until) >= 0) {
+        state->invulnerable = false;
+    }
+    return state->invulnerable;
 }
 
 bool game_state_is_game_over(GameState* state) {
@@ -96,5 +225,5 @@ bool game_state_is_game_over(GameState* state) {
 void game_state_set_game_over(GameState* state, bool game_over) {
     furi_assert(state);
     state->game_over = game_over;
-    FURI_LOG_I("GameState", "Game over status set to %s", game_over ? "true" : "false");
+    LASER_TAG_LOG_I("GameState", "Game over status set to %s", game_over ? "true" : "false");
 }
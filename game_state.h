@@ -2,32 +2,102 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef enum {
     LaserTagStateSplashScreen,
     LaserTagStateGame,
     LaserTagStateGameOver,
+    LaserTagStateDebug,
+    LaserTagStateWaiting, /**< Listening for a referee's start beacon. */
+    LaserTagStateReferee, /**< Running a match for everybody else. */
 } LaserTagState;
 
 typedef struct GameState GameState;
 
+/** Unsigned Q8.8 fixed point: 8 integer bits, 8 fractional bits. */
+typedef uint16_t GameStateQ8;
+#define GAME_STATE_Q8_ONE 256
+
+/** Player-visible fields, as reported back by game_state_apply(). */
+typedef enum {
+    GameStateFieldHealth = (1 << 0),
+    GameStateFieldShield = (1 << 1),
+    GameStateFieldAmmo = (1 << 2),
+    GameStateFieldTime = (1 << 3),
+    GameStateFieldGameOver = (1 << 4),
+    GameStateFieldLastHitBy = (1 << 5),
+} GameStateField;
+
+typedef struct {
+    uint32_t tick; /**< furi_get_tick() when the hit landed, for invulnerability. */
+    uint8_t player_id; /**< Shooter. */
+    uint8_t damage; /**< Base damage in hit points. */
+    GameStateQ8 multiplier; /**< Weapon multiplier, GAME_STATE_Q8_ONE for none. */
+} GameStateHit;
+
+/** Everything that happened since the last update; zero-initialise unused fields. */
+typedef struct {
+    const GameStateHit* hits;
+    size_t hit_count;
+    uint16_t ammo_used;
+    uint16_t ammo_gained;
+    uint8_t health_gained;
+    uint8_t shield_gained;
+    uint32_t elapsed_ms; /**< Game time to add, in milliseconds; drives regen. */
+} GameStateUpdate;
+
 GameState* game_state_alloc();
 void game_state_reset(GameState* state);
 
-void game_state_decrease_health(GameState* state, uint8_t amount);
-void game_state_increase_health(GameState* state, uint8_t amount);
-uint8_t game_state_get_health(GameState* state);
+/**
+ * @brief Applies a whole batch of changes in one pass.
+ * @details Regen and pickups go first, then hits in order, honouring invulnerability, then
+ * ammo use. Hits after the one that ends the game are ignored.
+ * @param state GameState to update.
+ * @param update Changes to apply.
+ * @return Mask of GameStateField values whose player-visible value changed.
+ */
+uint32_t game_state_apply(GameState* state, const GameStateUpdate* update);
+
+/**
+ * @brief Sets passive health regeneration for the rest of the round; every round starts at 0.
+ * @param state GameState to configure.
+ * @param per_second Hit points per second of game time, in Q8.8.
+ */
+void game_state_set_regen(GameState* state, GameStateQ8 per_second);
+GameStateQ8 game_state_get_regen(GameState* state);
 
-void game_state_decrease_ammo(GameState* state, uint16_t amount);
-void game_state_increase_ammo(GameState* state, uint16_t amount);
+// Health, shield and ammo only change through game_state_apply().
+uint8_t game_state_get_health(GameState* state);
+uint8_t game_state_get_shield(GameState* state);
 uint16_t game_state_get_ammo(GameState* state);
+int16_t game_state_get_last_hit_by(GameState* state);
+
+/** Hits that got past invulnerability this round, as applied by game_state_apply(). */
+uint32_t game_state_get_hits_taken(GameState* state);
 
-void game_state_update_time(GameState* state, uint32_t delta_time);
+/** Whole seconds of game time, as shown on the clock. */
 uint32_t game_state_get_time(GameState* state);
 
+/** Game time in milliseconds. */
+uint32_t game_state_get_time_ms(GameState* state);
+
+/** Moves the clock without regen, e.g. to line it up with a referee. */
+void game_state_set_time_ms(GameState* state, uint32_t time_ms);
+
+void game_state_start_invulnerability(GameState* state, uint32_t now);
+bool game_state_is_invulnerable(GameState* state, uint32_t now);
+
 bool game_state_is_game_over(GameState* state);
 void game_state_set_game_over(GameState* state, bool game_over);
 
 #define INITIAL_HEALTH 100
 #define INITIAL_AMMO   100
 #define MAX_HEALTH     100
+#define MAX_SHIELD     50
+
+#define HIT_INVULNERABILITY_MS 1000
+
+/** Returned by game_state_get_last_hit_by() before the first hit of a round. */
+#define GAME_STATE_NO_PLAYER (-1)
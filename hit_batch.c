@@ -0,0 +1,56 @@
+#include "hit_batch.h"
+#include "weapon.h"
+#include <furi.h>
+
+bool hit_batch_accept(const LaserTagPacket* packet, uint8_t player_id, uint8_t team_id) {
+    switch(packet->kind) {
+    case LaserTagPacketKindShoot:
+        return laser_tag_packet_is_hostile(packet, player_id, team_id);
+    case LaserTagPacketKindAck:
+        // ACKs for everybody else are just channel noise to us.
+        return packet->player_id == player_id;
+    case LaserTagPacketKindBeacon:
+        // Beacons are for everybody; the game loop knows which match it is in.
+        return true;
+    default:
+        return false;
+    }
+}
+
+void hit_batch_build(HitBatch* batch, const HitRecord* records, size_t count) {
+    furi_assert(batch);
+    furi_assert(records || count == 0);
+    furi_assert(count <= HIT_QUEUE_SIZE);
+
+    batch->hit_count = 0;
+    batch->ack_count = 0;
+    batch->beacon_count = 0;
+    batch->landed = 0;
+    for(size_t i = 0; i < count; i++) {
+        const LaserTagPacket* packet = &records[i].packet;
+        if(packet->kind == LaserTagPacketKindBeacon) {
+            batch->beacons[batch->beacon_count++] = i;
+        } else if(packet->kind == LaserTagPacketKindAck) {
+            batch->acks[batch->ack_count++] = i;
+        } else if(packet->kind == LaserTagPacketKindShoot) {
+            batch->shots[batch->hit_count] = i;
+            GameStateHit* hit = &batch->hits[batch->hit_count++];
+            hit->tick = records[i].tick;
+            hit->player_id = packet->player_id;
+            hit->damage = laser_tag_packet_get_damage(packet);
+            hit->multiplier = weapon_get_stats(packet->weapon)->multiplier;
+        }
+    }
+}
+
+bool hit_batch_apply(HitBatch* batch, GameState* state) {
+    furi_assert(batch);
+    furi_assert(state);
+
+    if(batch->hit_count == 0) return false;
+    uint32_t taken = game_state_get_hits_taken(state);
+    GameStateUpdate update = {.hits = batch->hits, .hit_count = batch->hit_count};
+    uint32_t changed = game_state_apply(state, &update);
+    batch->landed = game_state_get_hits_taken(state) - taken;
+    return (changed & (GameStateFieldHealth | GameStateFieldShield)) != 0;
+}
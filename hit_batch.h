@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+* @file hit_batch.h
+* @brief Which received packets count, and how a drained hit queue turns into one game update.
+* @details The IR RX callback asks hit_batch_accept() what is worth queueing. The game loop
+* hands each drained run of records to hit_batch_build(), which sorts them into a damage batch
+* for game_state_apply(), ACKs for the shot tracker and beacons for the match, in arrival order.
+* Nothing here touches the radio or the UI, so the host simulator runs the same decisions as
+* the device.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "game_state.h"
+#include "hit_queue.h"
+
+typedef struct {
+    GameStateHit hits[HIT_QUEUE_SIZE]; /**< Shots, ready for game_state_apply(). */
+    uint8_t shots[HIT_QUEUE_SIZE]; /**< Record index each entry of hits came from. */
+    size_t hit_count;
+    uint8_t acks[HIT_QUEUE_SIZE]; /**< Record indices of ACKs for our shots. */
+    size_t ack_count;
+    uint8_t beacons[HIT_QUEUE_SIZE]; /**< Record indices of referee beacons. */
+    size_t beacon_count;
+    size_t landed; /**< Set by hit_batch_apply(): hits that got past invulnerability. */
+} HitBatch;
+
+/**
+ * @brief Tells whether a received packet is for this player. Cheap enough for the RX callback.
+ * @details Hostile shots, ACKs addressed to us and every beacon are; friendly fire, self-hits
+ * and ACKs for other players are not.
+ * @param packet Decoded packet.
+ * @param player_id Receiving player id.
+ * @param team_id Receiving team id.
+ * @return true if the packet should be queued for the game loop.
+ */
+bool hit_batch_accept(const LaserTagPacket* packet, uint8_t player_id, uint8_t team_id);
+
+/**
+ * @brief Sorts drained records into shots, ACKs and beacons.
+ * @param batch Batch to fill; any previous contents are discarded.
+ * @param records Records as drained from the hit queue.
+ * @param count Number of records, at most HIT_QUEUE_SIZE.
+ */
+void hit_batch_build(HitBatch* batch, const HitRecord* records, size_t count);
+
+/**
+ * @brief Applies the batch's shots to the game state in one pass.
+ * @param batch Batch built by hit_batch_build().
+ * @param state GameState to damage.
+ * @return true if health or shield changed, i.e. the player felt it and the shooter gets an ACK.
+ */
+bool hit_batch_apply(HitBatch* batch, GameState* state);
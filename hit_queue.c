@@ -0,0 +1,50 @@
+#include "hit_queue.h"
+#include <string.h>
+
+#define HIT_QUEUE_MASK (HIT_QUEUE_SIZE - 1)
+
+_Static_assert((HIT_QUEUE_SIZE & HIT_QUEUE_MASK) == 0, "HIT_QUEUE_SIZE must be a power of two");
+
+void hit_queue_reset(HitQueue* queue) {
+    memset(queue, 0, sizeof(HitQueue));
+}
+
+void hit_queue_flush(HitQueue* queue) {
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    queue->dropped_base = __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->tail, head, __ATOMIC_RELEASE);
+}
+
+bool hit_queue_push(HitQueue* queue, const HitRecord* record) {
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if(head - tail >= HIT_QUEUE_SIZE) {
+        __atomic_store_n(&queue->dropped, queue->dropped + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    queue->records[head & HIT_QUEUE_MASK] = *record;
+    // Publish the record only after it has been fully written.
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t hit_queue_drain(HitQueue* queue, HitRecord* records, size_t max_count) {
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    size_t count = 0;
+    while(tail != head && count < max_count) {
+        records[count++] = queue->records[tail & HIT_QUEUE_MASK];
+        tail++;
+    }
+
+    // Hand the slots back to the producer in one store.
+    __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+    return count;
+}
+
+uint32_t hit_queue_get_dropped(const HitQueue* queue) {
+    return __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED) - queue->dropped_base;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+* @file hit_queue.h
+* @brief Lock-free single-producer/single-consumer queue of decoded IR hits.
+* @details The IR RX callback is the only producer and the game loop the only consumer. Both
+* counters run freely and are only ever written by their owner, so neither side needs a lock
+* and pushing never allocates. When the queue is full new hits are dropped and counted.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "laser_tag_packet.h"
+
+/** Queue capacity, must be a power of two. */
+#define HIT_QUEUE_SIZE 16
+
+/**
+ * @brief A single decoded hit.
+ */
+typedef struct {
+    uint32_t address; /**< Decoded IR address. */
+    uint32_t command; /**< Decoded IR command. */
+    uint32_t tick; /**< furi_get_tick() at decode time. */
+    uint32_t cycles; /**< laser_tag_profiler_now() at decode time. */
+    LaserTagPacket packet; /**< Packet decoded from address and command. */
+} HitRecord;
+
+typedef struct {
+    HitRecord records[HIT_QUEUE_SIZE];
+    uint32_t head; /**< Written by the producer only. */
+    uint32_t tail; /**< Written by the consumer only. */
+    uint32_t dropped; /**< Written by the producer only. */
+    uint32_t dropped_base; /**< Written by the consumer only, at flush time. */
+} HitQueue;
+
+/**
+ * @brief Empties the queue.
+ * @warning Only safe while the producer is stopped.
+ * @param queue HitQueue to reset.
+ */
+void hit_queue_reset(HitQueue* queue);
+
+/**
+ * @brief Discards every queued hit and restarts the dropped count. Consumer side only.
+ * @details Unlike hit_queue_reset() this is safe while the producer keeps running.
+ * @param queue HitQueue to flush.
+ */
+void hit_queue_flush(HitQueue* queue);
+
+/**
+ * @brief Pushes a hit. Producer side only.
+ * @param queue HitQueue to push to.
+ * @param record Hit to copy into the queue.
+ * @return true if the hit was queued, false if the queue was full and it was dropped.
+ */
+bool hit_queue_push(HitQueue* queue, const HitRecord* record);
+
+/**
+ * @brief Moves up to max_count queued hits into records. Consumer side only.
+ * @param queue HitQueue to drain.
+ * @param records Destination array.
+ * @param max_count Size of the destination array.
+ * @return Number of hits copied.
+ */
+size_t hit_queue_drain(HitQueue* queue, HitRecord* records, size_t max_count);
+
+/**
+ * @brief Returns the number of hits dropped because the queue was full.
+ * @param queue HitQueue to query.
+ * @return Dropped hit count since the last reset or flush.
+ */
+uint32_t hit_queue_get_dropped(const HitQueue* queue);
@@ -0,0 +1,582 @@
+/**
+* @file laser_tag_sim.c
+* @brief Host load test: a whole arena of units exchanging IR frames through the real game logic.
+* @details Every unit owns the same state the app does: a GameState, a ShotTracker, a
+* ShotScheduler and a HitQueue. Units carry the four weapons in turn, and random trigger pulls
+* become shots at each weapon's rate of fire. Shots and ACKs travel as NEC raw timings with
+* jitter, corrupted pulses and clipped tails. They go through laser_tag_raw_decoder,
+* laser_tag_packet and hit_batch_accept() into the hit queue, then out again through hit_batch
+* into game_state_apply(), as the RX callback and laser_tag_app_handle_hits() do on the device.
+* The firmware's stock NEC decoder is not available here, so the raw decoder carries every
+* frame.
+*
+* Time is simulated in 1 ms steps, so a run is reproducible for a given seed. Throughput and
+* latency are measured in host wall-clock time around the real code only.
+*
+* Instead of synthetic traffic, -f replays a script, one event per line:
+*   <ms> ir <unit> <timing> <timing> ...   raw capture delivered to a unit
+*   <ms> fire <unit>                       unit fires (ammo and shot tracker only)
+*   <ms> reload <unit>
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <furi.h>
+#include <time.h>
+#include <unistd.h>
+#include "game_state.h"
+#include "hit_batch.h"
+#include "hit_queue.h"
+#include "laser_tag_packet.h"
+#include "laser_tag_raw_decoder.h"
+#include "shot_scheduler.h"
+#include "shot_tracker.h"
+#include "weapon.h"
+
+#define SIM_MAX_PLAYERS LASER_TAG_PACKET_MAX_PLAYERS
+#define SIM_NEC_TIMINGS 67
+#define SIM_RESPAWN_MS  5000
+#define SIM_PENDING_MAX 1024
+#define SIM_LINE_MAX    4096
+
+typedef struct {
+    uint8_t id;
+    GameState* state;
+    ShotTracker* tracker;
+    ShotScheduler* scheduler;
+    HitQueue hits;
+    uint32_t next_pull;
+    uint32_t release_at;
+    uint32_t respawn_at; /**< Non-zero while the unit waits out a game over. */
+} SimUnit;
+
+/** A frame on its way to a unit, e.g. an ACK waiting out its random delay. */
+typedef struct {
+    uint32_t due;
+    uint8_t to;
+    uint32_t address;
+    uint32_t command;
+} SimPending;
+
+typedef struct {
+    uint64_t* samples;
+    size_t count;
+    size_t capacity;
+    uint64_t total;
+} SimTimes;
+
+typedef struct {
+    uint32_t pulls;
+    uint32_t shots[WeaponIdCount];
+    uint32_t frames_sent;
+    uint32_t frames_decoded;
+    uint32_t frames_rebuilt;
+    uint32_t frames_lost;
+    uint32_t frames_ignored; /**< Reached a unit waiting to respawn. */
+    uint32_t hits_queued;
+    uint32_t hits_hurt;
+    uint32_t hits_absorbed;
+    uint32_t hits_dropped;
+    uint32_t kills;
+    uint32_t acks_sent;
+    uint32_t acks_matched;
+    uint32_t beacons;
+    SimTimes decode;
+    SimTimes hit_path;
+} SimStats;
+
+typedef struct {
+    uint8_t players;
+    uint32_t seconds;
+    uint32_t pull_interval_ms; /**< Mean time between trigger pulls per unit. */
+    uint32_t noise_permille; /**< Chance that a single pulse is corrupted. */
+    uint32_t clip_permille; /**< Chance that a frame loses its tail. */
+    uint32_t jitter_us;
+    uint32_t seed;
+    const char* replay;
+} SimConfig;
+
+static SimUnit sim_units[SIM_MAX_PLAYERS];
+static SimPending sim_pending[SIM_PENDING_MAX];
+static size_t sim_pending_count;
+static SimStats sim_stats;
+static uint32_t sim_rng_state;
+
+static uint32_t sim_rand(void) {
+    // xorshift32, plenty for traffic shaping.
+    uint32_t x = sim_rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return sim_rng_state = x;
+}
+
+static uint64_t sim_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sim_times_add(SimTimes* times, uint64_t ns) {
+    if(times->count == times->capacity) {
+        times->capacity = times->capacity ? times->capacity * 2 : 1024;
+        times->samples = realloc(times->samples, times->capacity * sizeof(uint64_t));
+        furi_check(times->samples);
+    }
+    times->samples[times->count++] = ns;
+    times->total += ns;
+}
+
+static int sim_compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t sim_times_percentile(const SimTimes* times, unsigned percent) {
+    if(times->count == 0) return 0;
+    return times->samples[(times->count - 1) * percent / 100];
+}
+
+static size_t sim_encode_nec(uint32_t address, uint32_t command, uint32_t* timings) {
+    uint32_t frame = (address & 0xFF) | ((~address & 0xFF) << 8) | ((command & 0xFF) << 16) |
+                     ((~command & 0xFFUL) << 24);
+    size_t count = 0;
+    timings[count++] = 9000;
+    timings[count++] = 4500;
+    for(uint8_t bit = 0; bit < 32; bit++) {
+        timings[count++] = 560;
+        timings[count++] = (frame >> bit) & 1 ? 1690 : 560;
+    }
+    timings[count++] = 560;
+    return count;
+}
+
+// What a receiver a few metres away makes of a clean frame.
+static size_t sim_degrade(const SimConfig* config, uint32_t* timings, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        int32_t jitter =
+            config->jitter_us ? (int32_t)(sim_rand() % (2 * config->jitter_us + 1)) -
+                                    (int32_t)config->jitter_us :
+                                0;
+        int32_t value = (int32_t)timings[i] + jitter;
+        if(sim_rand() % 1000 < config->noise_permille) {
+            value = 100 + sim_rand() % 3000;
+        }
+        timings[i] = value > 50 ? (uint32_t)value : 50;
+    }
+    if(sim_rand() % 1000 < config->clip_permille) {
+        // Clipping only ever eats the tail; keep at least the leader and a few bits.
+        count -= sim_rand() % (count / 4);
+    }
+    return count;
+}
+
+static void sim_unit_reset(SimUnit* unit) {
+    game_state_reset(unit->state);
+    shot_tracker_reset(unit->tracker);
+    shot_scheduler_reset(unit->scheduler);
+    hit_queue_reset(&unit->hits);
+    unit->respawn_at = 0;
+}
+
+// The game loop's side of laser_tag_app_handle_hits(), without the UI and the recorder.
+static bool sim_unit_handle_hits(SimUnit* unit, const HitRecord* hits, size_t count) {
+    HitBatch batch;
+    hit_batch_build(&batch, hits, count);
+    sim_stats.beacons += batch.beacon_count;
+    for(size_t i = 0; i < batch.ack_count; i++) {
+        const HitRecord* ack = &hits[batch.acks[i]];
+        if(shot_tracker_match_ack(
+               unit->tracker, ack->tick, ack->packet.victim_id, ack->packet.kill)) {
+            sim_stats.acks_matched++;
+        }
+    }
+
+    bool hurt = hit_batch_apply(&batch, unit->state);
+    sim_stats.hits_hurt += batch.landed;
+    sim_stats.hits_absorbed += batch.hit_count - batch.landed;
+    return hurt;
+}
+
+static void sim_send_ack(SimUnit* victim, bool kill) {
+    int16_t shooter = game_state_get_last_hit_by(victim->state);
+    if(shooter == GAME_STATE_NO_PLAYER || sim_pending_count == SIM_PENDING_MAX) return;
+
+    LaserTagPacket ack = {
+        .kind = LaserTagPacketKindAck,
+        .player_id = shooter,
+        .victim_id = victim->id,
+        .kill = kill,
+    };
+    SimPending* pending = &sim_pending[sim_pending_count++];
+    laser_tag_packet_encode(&ack, &pending->address, &pending->command);
+    pending->to = shooter;
+    pending->due = furi_get_tick() + 5 + sim_rand() % 36;
+    sim_stats.acks_sent++;
+}
+
+// One raw capture arriving at a unit, through RX callback and game loop in one go.
+static void sim_unit_receive(SimUnit* unit, const uint32_t* timings, size_t count) {
+    if(unit->respawn_at) {
+        sim_stats.frames_ignored++;
+        return;
+    }
+
+    uint64_t start = sim_now_ns();
+    LaserTagRawFrame frame;
+    bool decoded = laser_tag_raw_decoder_decode(timings, count, &frame);
+    uint64_t decoded_at = sim_now_ns();
+    sim_times_add(&sim_stats.decode, decoded_at - start);
+    if(!decoded) {
+        sim_stats.frames_lost++;
+        return;
+    }
+    sim_stats.frames_decoded++;
+    if(frame.erasures) sim_stats.frames_rebuilt++;
+
+    // RX callback: the same filter as infrared_controller_handle_message(). Units never hear
+    // their own frames, so there is no echo to reject.
+    HitRecord record = {
+        .address = frame.address,
+        .command = frame.command,
+        .tick = furi_get_tick(),
+    };
+    if(!laser_tag_packet_decode(record.address, record.command, &record.packet) ||
+       !hit_batch_accept(&record.packet, unit->id, LASER_TAG_PACKET_TEAM_NONE)) {
+        return;
+    }
+    if(!hit_queue_push(&unit->hits, &record)) {
+        sim_stats.hits_dropped++;
+        return;
+    }
+    if(record.packet.kind == LaserTagPacketKindShoot) sim_stats.hits_queued++;
+
+    // Game loop: drain and apply.
+    HitRecord hits[HIT_QUEUE_SIZE];
+    size_t drained;
+    bool hurt = false;
+    while(!game_state_is_game_over(unit->state) &&
+          (drained = hit_queue_drain(&unit->hits, hits, COUNT_OF(hits))) > 0) {
+        hurt |= sim_unit_handle_hits(unit, hits, drained);
+    }
+    sim_times_add(&sim_stats.hit_path, sim_now_ns() - start);
+
+    if(hurt) {
+        bool kill = game_state_is_game_over(unit->state);
+        sim_send_ack(unit, kill);
+        if(kill) {
+            sim_stats.kills++;
+            unit->respawn_at = furi_get_tick() + SIM_RESPAWN_MS;
+        }
+    }
+}
+
+static void sim_deliver(const SimConfig* config, uint8_t to, uint32_t address, uint32_t command) {
+    uint32_t timings[SIM_NEC_TIMINGS];
+    size_t count = sim_encode_nec(address, command, timings);
+    count = sim_degrade(config, timings, count);
+    sim_stats.frames_sent++;
+    sim_unit_receive(&sim_units[to], timings, count);
+}
+
+// Mirrors laser_tag_app_fire() without the IR side.
+static bool sim_unit_fire(SimUnit* unit) {
+    if(unit->respawn_at || game_state_get_ammo(unit->state) == 0 ||
+       game_state_is_invulnerable(unit->state, furi_get_tick())) {
+        return false;
+    }
+    shot_tracker_record_shot(unit->tracker, furi_get_tick());
+    GameStateUpdate update = {.ammo_used = 1};
+    game_state_apply(unit->state, &update);
+    sim_stats.shots[shot_scheduler_get_weapon(unit->scheduler)]++;
+    return true;
+}
+
+static void sim_unit_shoot(const SimConfig* config, SimUnit* unit) {
+    // Most shots miss; a hit reaches one opponent in line of sight.
+    if(sim_rand() % 100 >= 40) return;
+    uint8_t victim = sim_rand() % (config->players - 1);
+    if(victim >= unit->id) victim++;
+
+    uint8_t weapon = shot_scheduler_get_weapon(unit->scheduler);
+    LaserTagPacket shot = {
+        .kind = LaserTagPacketKindShoot,
+        .player_id = unit->id,
+        .team_id = LASER_TAG_PACKET_TEAM_NONE,
+        .weapon = weapon,
+        .damage_class = weapon_get_stats(weapon)->damage_class,
+    };
+    uint32_t address;
+    uint32_t command;
+    laser_tag_packet_encode(&shot, &address, &command);
+    sim_deliver(config, victim, address, command);
+}
+
+// Mirrors laser_tag_app_run_weapon(); our own TX is never busy here, frames arrive instantly.
+static void sim_unit_run_weapon(const SimConfig* config, SimUnit* unit) {
+    ShotSchedulerAction action;
+    uint32_t wait;
+    while((action = shot_scheduler_poll(unit->scheduler, furi_get_tick(), false, &wait)) !=
+          ShotSchedulerActionNone) {
+        if(action == ShotSchedulerActionReloaded) {
+            GameStateUpdate update = {.ammo_gained = INITIAL_AMMO};
+            game_state_apply(unit->state, &update);
+        } else if(sim_unit_fire(unit)) {
+            sim_unit_shoot(config, unit);
+        } else {
+            shot_scheduler_cancel(unit->scheduler);
+            if(game_state_get_ammo(unit->state) == 0) {
+                shot_scheduler_reload(unit->scheduler, furi_get_tick());
+            }
+        }
+    }
+}
+
+static void sim_setup(uint8_t players) {
+    for(uint8_t i = 0; i < players; i++) {
+        SimUnit* unit = &sim_units[i];
+        unit->id = i;
+        unit->state = game_state_alloc();
+        unit->tracker = shot_tracker_alloc();
+        unit->scheduler = shot_scheduler_alloc();
+        furi_check(unit->state && unit->tracker && unit->scheduler);
+        shot_scheduler_set_weapon(unit->scheduler, i % WeaponIdCount);
+        sim_unit_reset(unit);
+    }
+}
+
+static void sim_tick(uint8_t players) {
+    for(uint8_t i = 0; i < players; i++) {
+        SimUnit* unit = &sim_units[i];
+        if(unit->respawn_at && (int32_t)(furi_get_tick() - unit->respawn_at) >= 0) {
+            sim_unit_reset(unit);
+        } else if(!unit->respawn_at && furi_get_tick() % 1000 == 0) {
+            GameStateUpdate update = {.elapsed_ms = 1000};
+            game_state_apply(unit->state, &update);
+        }
+    }
+}
+
+static void sim_run_synthetic(const SimConfig* config) {
+    for(uint8_t i = 0; i < config->players; i++) {
+        sim_units[i].next_pull = sim_rand() % config->pull_interval_ms;
+    }
+
+    uint32_t end = config->seconds * 1000;
+    for(furi_host_tick = 0; furi_host_tick < end; furi_host_tick++) {
+        sim_tick(config->players);
+
+        // ACKs whose random delay has run out.
+        for(size_t i = 0; i < sim_pending_count;) {
+            if((int32_t)(furi_get_tick() - sim_pending[i].due) >= 0) {
+                SimPending pending = sim_pending[i];
+                sim_pending[i] = sim_pending[--sim_pending_count];
+                sim_deliver(config, pending.to, pending.address, pending.command);
+            } else {
+                i++;
+            }
+        }
+
+        for(uint8_t i = 0; i < config->players; i++) {
+            SimUnit* unit = &sim_units[i];
+            if(unit->respawn_at) continue;
+
+            // Pulls come at random and are held for a while; the weapon decides the shots.
+            uint32_t now = furi_get_tick();
+            if(now >= unit->next_pull) {
+                unit->next_pull = now + 1 + sim_rand() % (2 * config->pull_interval_ms);
+                unit->release_at = now + sim_rand() % config->pull_interval_ms;
+                shot_scheduler_set_trigger(unit->scheduler, true);
+                sim_stats.pulls++;
+            }
+            if(now >= unit->release_at) shot_scheduler_set_trigger(unit->scheduler, false);
+            sim_unit_run_weapon(config, unit);
+        }
+    }
+}
+
+static bool sim_run_replay(const SimConfig* config) {
+    FILE* file = fopen(config->replay, "r");
+    if(!file) {
+        perror(config->replay);
+        return false;
+    }
+
+    static char line[SIM_LINE_MAX];
+    static uint32_t timings[SIM_LINE_MAX / 2];
+    uint32_t last_tick = 0;
+    size_t line_number = 0;
+    while(fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* cursor = line;
+        char* end;
+        if(*cursor == '#' || *cursor == '\n') continue;
+
+        unsigned long tick = strtoul(cursor, &end, 10);
+        char verb[16];
+        unsigned unit_id;
+        int consumed;
+        if(end == cursor || sscanf(end, " %15s %u%n", verb, &unit_id, &consumed) != 2 ||
+           unit_id >= config->players) {
+            fprintf(stderr, "%s:%zu: bad event\n", config->replay, line_number);
+            continue;
+        }
+        cursor = end + consumed;
+
+        for(; last_tick < tick; last_tick++) {
+            furi_host_tick = last_tick;
+            sim_tick(config->players);
+        }
+        furi_host_tick = tick;
+
+        SimUnit* unit = &sim_units[unit_id];
+        if(strcmp(verb, "ir") == 0) {
+            size_t count = 0;
+            unsigned long value;
+            while(count < COUNT_OF(timings) && (value = strtoul(cursor, &end, 10), end != cursor)) {
+                timings[count++] = value;
+                cursor = end;
+            }
+            sim_stats.frames_sent++;
+            sim_unit_receive(unit, timings, count);
+        } else if(strcmp(verb, "fire") == 0) {
+            sim_unit_fire(unit);
+        } else if(strcmp(verb, "reload") == 0) {
+            GameStateUpdate update = {.ammo_gained = INITIAL_AMMO};
+            game_state_apply(unit->state, &update);
+        } else {
+            fprintf(stderr, "%s:%zu: unknown event %s\n", config->replay, line_number, verb);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void sim_report(const SimConfig* config) {
+    SimStats* stats = &sim_stats;
+    qsort(stats->decode.samples, stats->decode.count, sizeof(uint64_t), sim_compare_u64);
+    qsort(stats->hit_path.samples, stats->hit_path.count, sizeof(uint64_t), sim_compare_u64);
+    double seconds = furi_get_tick() / 1000.0;
+    uint32_t received = stats->frames_decoded + stats->frames_lost;
+
+    printf("players %u, %.1f s simulated, seed %lu\n", config->players, seconds,
+           (unsigned long)config->seed);
+    printf(
+        "frames    sent %lu, ignored %lu, decoded %lu (%.1f%%), rebuilt %lu, lost %lu\n",
+        (unsigned long)stats->frames_sent,
+        (unsigned long)stats->frames_ignored,
+        (unsigned long)stats->frames_decoded,
+        received ? 100.0 * stats->frames_decoded / received : 0.0,
+        (unsigned long)stats->frames_rebuilt,
+        (unsigned long)stats->frames_lost);
+    printf(
+        "hits      queued %lu, hurt %lu, absorbed %lu, dropped %lu, kills %lu\n",
+        (unsigned long)stats->hits_queued,
+        (unsigned long)stats->hits_hurt,
+        (unsigned long)stats->hits_absorbed,
+        (unsigned long)stats->hits_dropped,
+        (unsigned long)stats->kills);
+    printf("shots    ");
+    for(uint8_t weapon = 0; weapon < WeaponIdCount; weapon++) {
+        printf(" %s %lu,", weapon_get_stats(weapon)->name, (unsigned long)stats->shots[weapon]);
+    }
+    printf(" from %lu pulls\n", (unsigned long)stats->pulls);
+    printf(
+        "acks      sent %lu, matched %lu, beacons %lu\n",
+        (unsigned long)stats->acks_sent,
+        (unsigned long)stats->acks_matched,
+        (unsigned long)stats->beacons);
+    if(seconds > 0) {
+        printf(
+            "arena     %.1f frames/s, %.1f hits/s\n",
+            stats->frames_sent / seconds,
+            stats->hits_queued / seconds);
+    }
+
+    const struct {
+        const char* name;
+        const SimTimes* times;
+    } spans[] = {
+        {"decode", &stats->decode},
+        {"hit path", &stats->hit_path},
+    };
+    for(size_t i = 0; i < COUNT_OF(spans); i++) {
+        const SimTimes* times = spans[i].times;
+        if(!times->count) continue;
+        printf(
+            "%-9s %.2f M/s, p50 %llu ns, p99 %llu ns, max %llu ns\n",
+            spans[i].name,
+            times->total ? times->count * 1000.0 / times->total : 0.0,
+            (unsigned long long)sim_times_percentile(times, 50),
+            (unsigned long long)sim_times_percentile(times, 99),
+            (unsigned long long)times->samples[times->count - 1]);
+    }
+}
+
+static void sim_usage(const char* name) {
+    fprintf(
+        stderr,
+        "usage: %s [-p players] [-t seconds] [-i pull_ms] [-n noise_permille]\n"
+        "          [-c clip_permille] [-j jitter_us] [-s seed] [-f replay] [-v]\n",
+        name);
+}
+
+int main(int argc, char** argv) {
+    SimConfig config = {
+        .players = 32,
+        .seconds = 600,
+        .pull_interval_ms = 700,
+        .noise_permille = 5,
+        .clip_permille = 50,
+        .jitter_us = 120,
+        .seed = 1,
+        .replay = NULL,
+    };
+
+    int option;
+    while((option = getopt(argc, argv, "p:t:i:n:c:j:s:f:vh")) != -1) {
+        switch(option) {
+        case 'p':
+            config.players = MIN(MAX(atoi(optarg), 2), SIM_MAX_PLAYERS);
+            break;
+        case 't':
+            config.seconds = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            config.pull_interval_ms = MAX(strtoul(optarg, NULL, 10), 1UL);
+            break;
+        case 'n':
+            config.noise_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            config.clip_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            config.jitter_us = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            config.replay = optarg;
+            break;
+        case 'v':
+            furi_host_log_level++;
+            break;
+        default:
+            sim_usage(argv[0]);
+            return option == 'h' ? 0 : 2;
+        }
+    }
+
+    sim_rng_state = config.seed ? config.seed : 1;
+    sim_setup(config.players);
+    if(config.replay) {
+        if(!sim_run_replay(&config)) return 1;
+    } else {
+        sim_run_synthetic(&config);
+    }
+    sim_report(&config);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <furi.h>
+#include <stdarg.h>
+
+uint32_t furi_host_tick = 0;
+int furi_host_log_level = 1;
+
+void furi_host_log(const char* letter, const char* tag, const char* format, ...) {
+    fprintf(stderr, "%lu [%s][%s] ", (unsigned long)furi_host_tick, letter, tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void furi_host_crash(const char* file, int line, const char* expression) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    abort();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+* @file furi.h
+* @brief Host stand-in for the handful of furi APIs the portable game logic uses.
+* @details Only what the sources listed in host/Makefile need. The tick is a simulated
+* millisecond clock that the harness advances itself, so runs are deterministic and independent
+* of the host's speed.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNUSED(x)   (void)(x)
+#define COUNT_OF(x) (sizeof(x) / sizeof((x)[0]))
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+void furi_host_crash(const char* file, int line, const char* expression);
+
+#define furi_check(x) ((x) ? (void)0 : furi_host_crash(__FILE__, __LINE__, #x))
+#define furi_assert(x) furi_check(x)
+
+#define FURI_CRITICAL_ENTER()
+#define FURI_CRITICAL_EXIT()
+
+/** Messages at or below this level are printed: 1 error, 2 warn, 3 info, 4 debug. */
+extern int furi_host_log_level;
+
+/**
+ * @brief Prints one log line to stderr. Use the FURI_LOG_* macros instead.
+ * @details Format checked like the firmware's logger, so the host build catches arguments that
+ * would not match on the 32-bit target or here.
+ */
+void furi_host_log(const char* letter, const char* tag, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// The level is checked first so filtered calls do not even evaluate their arguments.
+#define FURI_HOST_LOG(level, letter, tag, format, ...)         \
+    do {                                                       \
+        if(furi_host_log_level >= (level)) {                   \
+            furi_host_log(letter, tag, format, ##__VA_ARGS__); \
+        }                                                      \
+    } while(0)
+
+#define FURI_LOG_E(tag, format, ...) FURI_HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_W(tag, format, ...) FURI_HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_I(tag, format, ...) FURI_HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_D(tag, format, ...) FURI_HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+
+/** Simulated time in milliseconds; one tick per millisecond as on the device. */
+extern uint32_t furi_host_tick;
+
+static inline uint32_t furi_get_tick(void) {
+    return furi_host_tick;
+}
+
+static inline uint32_t furi_ms_to_ticks(uint32_t milliseconds) {
+    return milliseconds;
+}
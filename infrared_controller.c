@@ -2,22 +2,53 @@
 #include <furi.h>
 #include <infrared_worker.h>
 #include <infrared_signal.h>
+#include <infrared_transmit.h>
 #include <notification/notification_messages.h>
 #include <furi_hal_gpio.h>
 #include <furi_hal_power.h>
 #include <furi_hal_infrared.h>
+#include <furi_hal_random.h>
+#include <furi_hal_resources.h>
+#include <furi_hal_cortex.h>
+#include "laser_tag_profiler.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include "laser_tag_raw_decoder.h"
+#include "hit_batch.h"
 
 #define TAG "InfraredController"
 
-const NotificationSequence sequence_hit = {
-    &message_vibro_on,
-    &message_note_d4,
-    &message_delay_1000,
-    &message_vibro_off,
-    &message_sound_off,
-    NULL,
+#define INFRARED_CONTROLLER_TX_STACK_SIZE 1024
+
+// Plugging a board in is a human-speed event; twice a second feels instant.
+#define INFRARED_CONTROLLER_BOARD_POLL_MS 500
+
+typedef struct {
+    const char* name;
+    uint32_t frequency;
+    float duty_cycle;
+} InfraredControllerTxProfileParams;
+
+// Receivers are tuned to 38 kHz; detuning the carrier is the cheapest way to shorten range.
+static const InfraredControllerTxProfileParams
+    infrared_controller_tx_profiles[InfraredControllerTxProfileCount] = {
+        [InfraredControllerTxProfileClose] = {"Close", 40000, 0.15f},
+        [InfraredControllerTxProfileStandard] = {"Standard", 38000, 0.33f},
+        [InfraredControllerTxProfileLong] = {"Long", 38000, 0.50f},
 };
 
+typedef enum {
+    InfraredControllerTxEventShoot = (1 << 0),
+    InfraredControllerTxEventExit = (1 << 1),
+    InfraredControllerTxEventAck = (1 << 2),
+    InfraredControllerTxEventBoard = (1 << 3),
+    InfraredControllerTxEventBeacon = (1 << 4),
+    InfraredControllerTxEventAll =
+        (InfraredControllerTxEventShoot | InfraredControllerTxEventExit |
+         InfraredControllerTxEventAck | InfraredControllerTxEventBoard |
+         InfraredControllerTxEventBeacon),
+} InfraredControllerTxEvent;
+
 const NotificationSequence sequence_bloop = {
     &message_note_g3,
     &message_delay_50,
@@ -27,8 +58,6 @@ const NotificationSequence sequence_bloop = {
 
 extern const NotificationSequence sequence_short_beep;
 
-static bool external_board_connected = false;
-
 static void infrared_setup_external_board(bool enable) {
     if(enable) {
         furi_hal_gpio_init(&gpio_ext_pa7, GpioModeOutputPushPull, GpioPullNo, GpioSpeedVeryHigh);
@@ -41,199 +70,815 @@ static void infrared_setup_external_board(bool enable) {
     }
 }
 
-void update_infrared_board_status(InfraredController* controller) {
-    if(!controller || !controller->notification) return;
-
-    FuriHalInfraredTxPin detected_pin = furi_hal_infrared_detect_tx_output();
-
-    if(detected_pin == FuriHalInfraredTxPinExtPA7 && !external_board_connected) {
-        external_board_connected = true;
+// Runs on the TX thread, or before it starts, so detection never probes PA7 under a shot.
+static void infrared_controller_poll_board(InfraredController* controller) {
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    bool attached = furi_hal_infrared_detect_tx_output() == FuriHalInfraredTxPinExtPA7;
+    if(attached && !controller->board_attached) {
+        controller->board_attached = true;
         infrared_setup_external_board(true);
         notification_message(controller->notification, &sequence_short_beep);
-        FURI_LOG_I(TAG, "External infrared board connected and powered.");
-    } else if(detected_pin == FuriHalInfraredTxPinInternal && external_board_connected) {
-        external_board_connected = false;
+        LASER_TAG_LOG_I(TAG, "External infrared board connected and powered.");
+    } else if(!attached && controller->board_attached) {
+        controller->board_attached = false;
         infrared_setup_external_board(false);
         notification_message(controller->notification, &sequence_bloop);
-        FURI_LOG_I(TAG, "External infrared board disconnected and power disabled.");
+        LASER_TAG_LOG_I(TAG, "External infrared board disconnected and power disabled.");
     }
+    furi_mutex_release(controller->ir_mutex);
 }
 
-static void infrared_reset(void* context, uint32_t arg) {
-    UNUSED(arg);
-    InfraredController* controller = (InfraredController*)context;
-    // furi_stream_buffer_reset(instance->stream) not exposed to the API.
-    // infrared_worker_rx_stop calls it internally.
-    infrared_worker_rx_stop(controller->worker);
-    infrared_worker_rx_start(controller->worker);
-    controller->processing_signal = false;
+static void infrared_controller_board_timer_callback(void* context) {
+    InfraredController* controller = context;
+    // Detection itself is left to the TX thread, which knows when the pin is idle.
+    furi_thread_flags_set(
+        furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventBoard);
 }
 
-static void infrared_rx_callback(void* context, InfraredWorkerSignal* received_signal) {
-    FURI_LOG_I(TAG, "RX callback triggered");
+// Callers must hold ir_mutex.
+static void infrared_controller_rx_start(InfraredController* controller) {
+    if(!controller->worker_rx_active) {
+        infrared_worker_rx_start(controller->worker);
+        controller->worker_rx_active = true;
+    }
+}
 
-    InfraredController* controller = (InfraredController*)context;
-    if(controller->processing_signal) {
-        FURI_LOG_W(TAG, "Already processing a signal, skipping callback");
+// Callers must hold ir_mutex.
+static void infrared_controller_rx_stop(InfraredController* controller) {
+    if(controller->worker_rx_active) {
+        infrared_worker_rx_stop(controller->worker);
+        controller->worker_rx_active = false;
+    }
+}
+
+static bool infrared_controller_is_echo(InfraredController* controller, const InfraredMessage* message) {
+    return message->address == controller->tx_address &&
+           message->command == controller->tx_command &&
+           (furi_get_tick() - controller->tx_end_tick) <
+               furi_ms_to_ticks(INFRARED_CONTROLLER_ECHO_WINDOW_MS);
+}
+
+static void infrared_controller_queue_hit(
+    InfraredController* controller,
+    const InfraredMessage* message,
+    const LaserTagPacket* packet) {
+    HitRecord record = {
+        .address = message->address,
+        .command = message->command,
+        .tick = furi_get_tick(),
+        .cycles = laser_tag_profiler_now(),
+        .packet = *packet,
+    };
+    if(!hit_queue_push(&controller->hits, &record)) {
+        FURI_LOG_W(TAG, "Hit queue full, dropping hit");
         return;
     }
 
-    controller->processing_signal = true;
+    // Wake the game loop once per batch; it clears the flag before draining.
+    if(!__atomic_exchange_n(&controller->hit_event_pending, true, __ATOMIC_ACQ_REL) &&
+       controller->hit_callback) {
+        controller->hit_callback(controller->hit_callback_context);
+    }
+}
+
+static void infrared_controller_handle_message(
+    InfraredController* controller,
+    const InfraredMessage* message) {
+    LASER_TAG_LOG_I(
+        TAG,
+        "Received message: protocol=%d, address=0x%lx, command=0x%lx",
+        message->protocol,
+        (unsigned long)message->address,
+        (unsigned long)message->command);
+
+    LaserTagPacket packet;
+    if(message->protocol != InfraredProtocolNEC ||
+       !laser_tag_packet_decode(message->address, message->command, &packet)) {
+        LASER_TAG_LOG_D(TAG, "Not a laser tag packet");
+    } else if(infrared_controller_is_echo(controller, message)) {
+        LASER_TAG_LOG_D(TAG, "Ignoring echo of our own shot");
+    } else if(hit_batch_accept(
+                  &packet, controller->shot_packet.player_id, controller->shot_packet.team_id)) {
+        // Feedback is up to the game loop; returning right away keeps the
+        // worker listening for the next frame.
+        infrared_controller_queue_hit(controller, message, &packet);
+        LASER_TAG_LOG_I(
+            TAG, "Queued packet kind %d from player %d", packet.kind, packet.player_id);
+    } else {
+        LASER_TAG_LOG_D(
+            TAG, "Ignoring packet kind %d from player %d", packet.kind, packet.player_id);
+    }
+}
+
+static void infrared_rx_callback(void* context, InfraredWorkerSignal* received_signal) {
+    LASER_TAG_LOG_I(TAG, "RX callback triggered");
+
+    InfraredController* controller = (InfraredController*)context;
 
     if(!received_signal) {
         FURI_LOG_E(TAG, "Received signal is NULL");
-        controller->processing_signal = false;
         return;
     }
 
     const InfraredMessage* message = infrared_worker_get_decoded_signal(received_signal);
-    FURI_LOG_I(TAG, "Received signal - signal address: %p", (void*)received_signal);
+    LASER_TAG_LOG_I(TAG, "Received signal - signal address: %p", (void*)received_signal);
 
     if(message) {
-        FURI_LOG_I(
-            TAG,
-            "Received message: protocol=%d, address=0x%lx, command=0x%lx",
-            message->protocol,
-            (unsigned long)message->address,
-            (unsigned long)message->command);
-
-        if (message->command == IR_COMMAND_SHOOT) {
-            controller->hit_received = true;
-            FURI_LOG_I(TAG, "Hit detected");
-            notification_message_block(controller->notification, &sequence_hit);
+        infrared_controller_handle_message(controller, message);
+        return;
+    }
+
+    // The stock decoder gave up; a clipped or noisy shot may still be in the raw timings.
+    if(controller->raw_decoding) {
+        const uint32_t* timings;
+        size_t timings_size;
+        LaserTagRawFrame frame;
+        infrared_worker_get_raw_signal(received_signal, &timings, &timings_size);
+        if(laser_tag_raw_decoder_decode(timings, timings_size, &frame)) {
+            __atomic_add_fetch(&controller->rx_recovered, 1, __ATOMIC_RELAXED);
+            LASER_TAG_LOG_D(TAG, "Recovered raw frame, %d bits rebuilt", frame.erasures);
+            InfraredMessage recovered = {
+                .protocol = InfraredProtocolNEC,
+                .address = frame.address,
+                .command = frame.command,
+            };
+            infrared_controller_handle_message(controller, &recovered);
+            return;
         }
+    }
+
+    // In a crowded room this is mostly overlapping frames; count them rather than spam.
+    __atomic_add_fetch(&controller->rx_garbled, 1, __ATOMIC_RELAXED);
+    LASER_TAG_LOG_D(TAG, "RX callback received NULL message");
+}
+
+// Turns one frame into raw marks and spaces. Returns the number of timings written, 0 if the
+// encoder failed or the frame does not fit.
+static size_t infrared_controller_encode_frame(
+    const InfraredMessage* message,
+    uint32_t* timings,
+    size_t timings_max) {
+    size_t timings_size = 0;
+    bool last_level = false;
+
+    InfraredEncoderHandler* encoder = infrared_alloc_encoder();
+    infrared_reset_encoder(encoder, message);
+
+    InfraredStatus status;
+    do {
+        uint32_t duration;
+        bool level;
+        status = infrared_encode(encoder, &duration, &level);
+        if(status == InfraredStatusError) break;
+
+        if(timings_size == 0 && !level) {
+            // Raw transmission always starts from a mark.
+            continue;
+        } else if(timings_size > 0 && level == last_level) {
+            timings[timings_size - 1] += duration;
+        } else if(timings_size < timings_max) {
+            timings[timings_size++] = duration;
+            last_level = level;
+        } else {
+            status = InfraredStatusError;
+        }
+    } while(status == InfraredStatusOk);
+
+    infrared_free_encoder(encoder);
+
+    // A trailing space is only the gap before a repeat frame.
+    if(timings_size > 0 && !last_level) {
+        timings_size--;
+    }
+    return status == InfraredStatusDone ? timings_size : 0;
+}
+
+// Callers must hold ir_mutex. Every view keeps its timings and only takes the profile's
+// carrier, so switching profiles never re-encodes.
+static void infrared_controller_apply_tx_profile(InfraredController* controller) {
+    const InfraredControllerTxProfileParams* profile =
+        &infrared_controller_tx_profiles[controller->tx_profile];
+    for(size_t i = 0; i < WeaponIdCount; i++) {
+        InfraredControllerShot* shot = &controller->shots[i];
+        if(!shot->timings) continue;
+        infrared_signal_set_raw_view(
+            shot->signal,
+            shot->timings,
+            shot->timings_size,
+            profile->frequency,
+            profile->duty_cycle);
+    }
+}
+
+// Callers must hold ir_mutex. The pool only ever holds the current player's weapon set, so it
+// is rebuilt from scratch; switching weapons afterwards only picks another view.
+static void infrared_controller_encode_weapon_set(InfraredController* controller) {
+    infrared_timings_pool_reset(&controller->timings_pool);
+    size_t total = 0;
+    for(uint8_t weapon = 0; weapon < WeaponIdCount; weapon++) {
+        InfraredControllerShot* shot = &controller->shots[weapon];
+        LaserTagPacket packet = controller->shot_packet;
+        packet.weapon = weapon;
+        packet.damage_class = weapon_get_stats(weapon)->damage_class;
+        shot->message = (InfraredMessage){.protocol = InfraredProtocolNEC};
+        laser_tag_packet_encode(&packet, &shot->message.address, &shot->message.command);
+
+        size_t available;
+        uint32_t* timings = infrared_timings_pool_reserve(&controller->timings_pool, &available);
+        shot->timings_size = infrared_controller_encode_frame(&shot->message, timings, available);
+        if(shot->timings_size) {
+            infrared_timings_pool_commit(&controller->timings_pool, shot->timings_size);
+            shot->timings = timings;
+            total += shot->timings_size;
+        } else {
+            FURI_LOG_W(TAG, "Failed to pre-encode weapon %d, falling back to the encoder", weapon);
+            shot->timings = NULL;
+            infrared_signal_set_message(shot->signal, &shot->message);
+        }
+    }
+    infrared_controller_apply_tx_profile(controller);
+    LASER_TAG_LOG_I(TAG, "Weapon set pre-encoded into %zu timings", total);
+}
+
+// The receiver output idles high and is pulled low for every carrier burst. While the RX worker
+// is running it holds the pin as an input; sampling it is a plain read and does not get in its
+// way. With the worker stopped the pin is parked in analog mode and always reads low, so it
+// must only be sampled while the receiver is armed.
+static bool infrared_controller_channel_busy(void) {
+    FuriHalCortexTimer timer = furi_hal_cortex_timer_get(INFRARED_CONTROLLER_CS_WINDOW_US);
+    while(!furi_hal_cortex_timer_is_expired(timer)) {
+        if(!furi_hal_gpio_read(&gpio_infrared_rx)) return true;
+        furi_delay_us(INFRARED_CONTROLLER_CS_SAMPLE_US);
+    }
+    return false;
+}
+
+// Listen before talking: on a busy channel, back off for a random number of slots from a
+// window that doubles per attempt. After the last attempt the frame goes out regardless, which
+// bounds the added latency. A parked unit or a referee has no receiver armed and cannot hear
+// the channel, so it transmits straight away.
+static void infrared_controller_wait_for_channel(InfraredController* controller) {
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    bool listening = controller->worker_rx_active;
+    furi_mutex_release(controller->ir_mutex);
+    if(!listening) return;
+
+    for(uint8_t attempt = 0; attempt < INFRARED_CONTROLLER_CS_MAX_ATTEMPTS; attempt++) {
+        if(!infrared_controller_channel_busy()) return;
+
+        __atomic_add_fetch(&controller->cs_deferrals, 1, __ATOMIC_RELAXED);
+        uint32_t slots = furi_hal_random_get() % (2U << attempt);
+        furi_delay_us(INFRARED_CONTROLLER_CS_SLOT_US * (slots + 1));
+    }
+    __atomic_add_fetch(&controller->cs_forced, 1, __ATOMIC_RELAXED);
+    LASER_TAG_LOG_D(TAG, "Channel still busy, transmitting anyway");
+}
+
+static void infrared_controller_sample_current(InfraredController* controller) {
+    InfraredControllerTxProfile profile = controller->tx_profile;
+    // The gauge reports discharge as negative amps; store the draw in mA.
+    int32_t draw_ma =
+        (int32_t)(-furi_hal_power_get_battery_current(FuriHalPowerICFuelGauge) * 1000.0f);
+    int32_t* average = &controller->tx_current_ma[profile];
+    if(controller->tx_current_samples[profile]++ == 0) {
+        *average = draw_ma;
+    } else {
+        *average += (draw_ma - *average) / (1 << INFRARED_CONTROLLER_TX_CURRENT_SHIFT);
+    }
+}
+
+// Callers must hold ir_mutex, so nothing else goes on air between the stamp and the frame.
+static void
+    infrared_controller_stamp_sync(InfraredController* controller, InfraredMessage* frame) {
+    uint32_t epoch = __atomic_load_n(&controller->beacon_epoch, __ATOMIC_ACQUIRE);
+    uint64_t elapsed_ms =
+        (uint64_t)(furi_get_tick() - epoch) * 1000 / furi_kernel_get_tick_frequency();
+    LaserTagPacket packet = {
+        .kind = LaserTagPacketKindBeacon,
+        .beacon = LaserTagPacketBeaconSync,
+        .beacon_value =
+            (elapsed_ms + LASER_TAG_PACKET_FRAME_MS) & LASER_TAG_PACKET_BEACON_VALUE_MASK,
+    };
+    laser_tag_packet_encode(&packet, &frame->address, &frame->command);
+}
+
+// frame is NULL for our own cached shot. A sync beacon is stamped right before it goes on air.
+static void infrared_controller_transmit(
+    InfraredController* controller,
+    InfraredMessage* frame,
+    bool sync) {
+    __atomic_store_n(&controller->tx_active, true, __ATOMIC_RELEASE);
+    infrared_controller_wait_for_channel(controller);
+
+    // The infrared HAL is half-duplex, so the receiver is only disarmed for the
+    // time the frame is actually on air and re-armed right after.
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    infrared_controller_rx_stop(controller);
+
+    // The weapon can change between request and transmission; whatever is picked now goes out.
+    const InfraredControllerShot* shot = &controller->shots[controller->shot_packet.weapon];
+    const InfraredSignal* preset = frame ? NULL : controller->shot_preset;
+    if(sync) infrared_controller_stamp_sync(controller, frame);
+    const InfraredMessage* message = frame ? frame : &shot->message;
+    if(preset) {
+        // A raw preset has no frame to recognise as our echo.
+        static const InfraredMessage no_echo = {.address = UINT32_MAX, .command = UINT32_MAX};
+        message = infrared_signal_is_raw(preset) ? &no_echo : infrared_signal_get_message(preset);
+    }
+    LASER_TAG_LOG_I(
+        TAG,
+        "Sending message: protocol=%d, address=0x%lx, command=0x%lx",
+        message->protocol,
+        (unsigned long)message->address,
+        (unsigned long)message->command);
+    controller->tx_address = message->address;
+    controller->tx_command = message->command;
+    if(frame) {
+        // ACKs and beacons are rare enough that encoding them on the fly is fine.
+        infrared_send(frame, 1);
     } else {
-        FURI_LOG_W(TAG, "RX callback received NULL message");
+        uint32_t tx_start = laser_tag_profiler_now();
+        laser_tag_profiler_record(LaserTagProfilerSpanFireToTx, controller->tx_request_cycles);
+        infrared_signal_transmit(preset ? preset : shot->signal);
+        laser_tag_profiler_record(LaserTagProfilerSpanTx, tx_start);
+    }
+    controller->tx_end_tick = furi_get_tick();
+
+    if(controller->rx_enabled) {
+        infrared_controller_rx_start(controller);
+    }
+    furi_mutex_release(controller->ir_mutex);
+    __atomic_store_n(&controller->tx_active, false, __ATOMIC_RELEASE);
+
+    if(!frame) {
+        infrared_controller_sample_current(controller);
     }
 
-    FURI_LOG_I(TAG, "RX callback completed");
-    furi_timer_pending_callback(infrared_reset, controller, 0);
+    LASER_TAG_LOG_I(TAG, "Infrared signal transmission completed");
+}
+
+static uint32_t infrared_controller_ack_delay(void) {
+    // Victims of the same burst must not all answer in the same slot.
+    uint32_t spread = INFRARED_CONTROLLER_ACK_DELAY_MAX_MS - INFRARED_CONTROLLER_ACK_DELAY_MIN_MS;
+    return furi_ms_to_ticks(
+        INFRARED_CONTROLLER_ACK_DELAY_MIN_MS + furi_hal_random_get() % (spread + 1));
+}
+
+static void infrared_controller_transmit_ack(InfraredController* controller) {
+    uint32_t request = __atomic_exchange_n(&controller->ack_request, 0, __ATOMIC_ACQ_REL);
+    if(!request) return;
+
+    InfraredMessage ack = {
+        .protocol = InfraredProtocolNEC,
+        .address = (request >> 8) & 0xFF,
+        .command = request & 0xFF,
+    };
+    infrared_controller_transmit(controller, &ack, false);
+}
+
+static void infrared_controller_transmit_beacon(InfraredController* controller) {
+    uint32_t request = __atomic_exchange_n(&controller->beacon_request, 0, __ATOMIC_ACQ_REL);
+    if(!request) return;
+
+    LaserTagPacket packet = {
+        .kind = LaserTagPacketKindBeacon,
+        .beacon = (request >> 16) & 0xFF,
+        .beacon_value = request & LASER_TAG_PACKET_BEACON_VALUE_MASK,
+    };
+    InfraredMessage beacon = {.protocol = InfraredProtocolNEC};
+    laser_tag_packet_encode(&packet, &beacon.address, &beacon.command);
+    LASER_TAG_LOG_I(TAG, "Sending beacon %d", packet.beacon);
+    infrared_controller_transmit(controller, &beacon, packet.beacon == LaserTagPacketBeaconSync);
+}
+
+static int32_t infrared_controller_tx_thread(void* context) {
+    InfraredController* controller = context;
+    bool ack_armed = false;
+    uint32_t ack_due = 0;
+
+    while(true) {
+        uint32_t timeout = FuriWaitForever;
+        if(ack_armed) {
+            int32_t left = (int32_t)(ack_due - furi_get_tick());
+            timeout = left > 0 ? (uint32_t)left : 0;
+        }
+
+        // A timeout just means the pending ACK is due.
+        uint32_t flags =
+            furi_thread_flags_wait(InfraredControllerTxEventAll, FuriFlagWaitAny, timeout);
+        if(flags & FuriFlagError) flags = 0;
+        if(flags & InfraredControllerTxEventExit) break;
+
+        if(flags & InfraredControllerTxEventBoard) {
+            infrared_controller_poll_board(controller);
+        }
+
+        if((flags & InfraredControllerTxEventAck) && !ack_armed) {
+            ack_armed = true;
+            ack_due = furi_get_tick() + infrared_controller_ack_delay();
+        }
+
+        // Shots requested while one is on air are sent back to back, ahead of any ACK.
+        while(__atomic_load_n(&controller->tx_pending, __ATOMIC_ACQUIRE) > 0) {
+            __atomic_sub_fetch(&controller->tx_pending, 1, __ATOMIC_ACQ_REL);
+            infrared_controller_transmit(controller, NULL, false);
+        }
+
+        // Only a referee sends beacons, and a referee does not shoot.
+        if(flags & InfraredControllerTxEventBeacon) {
+            infrared_controller_transmit_beacon(controller);
+        }
+
+        if(ack_armed && (int32_t)(furi_get_tick() - ack_due) >= 0) {
+            ack_armed = false;
+            infrared_controller_transmit_ack(controller);
+        }
+    }
+
+    return 0;
+}
+
+// Undoes a partial infrared_controller_alloc(), newest resource first. The arena hands out
+// zeroed memory, so anything not allocated yet is NULL.
+static void infrared_controller_unwind(InfraredController* controller) {
+    if(controller->board_attached) {
+        controller->board_attached = false;
+        infrared_setup_external_board(false);
+    }
+    if(controller->tx_thread) furi_thread_free(controller->tx_thread);
+    if(controller->board_timer) furi_timer_free(controller->board_timer);
+    if(controller->ir_mutex) furi_mutex_free(controller->ir_mutex);
+    if(controller->notification) furi_record_close(RECORD_NOTIFICATION);
+    for(size_t i = WeaponIdCount; i-- > 0;) {
+        if(controller->shots[i].signal) infrared_signal_free(controller->shots[i].signal);
+    }
+    if(controller->worker) infrared_worker_free(controller->worker);
 }
 
 InfraredController* infrared_controller_alloc() {
-    FURI_LOG_I(TAG, "Allocating InfraredController");
+    LASER_TAG_LOG_I(TAG, "Allocating InfraredController");
 
-    InfraredController* controller = malloc(sizeof(InfraredController));
+    InfraredController* controller = laser_tag_arena_alloc(sizeof(InfraredController));
     if(!controller) {
         FURI_LOG_E(TAG, "Failed to allocate InfraredController");
         return NULL;
     }
 
     controller->worker = infrared_worker_alloc();
-    controller->signal = infrared_signal_alloc();
+    bool signals_allocated = true;
+    for(size_t i = 0; i < WeaponIdCount; i++) {
+        controller->shots[i].signal = infrared_signal_alloc();
+        signals_allocated &= controller->shots[i].signal != NULL;
+    }
+    controller->tx_profile = InfraredControllerTxProfileStandard;
+    controller->shot_preset = NULL;
+    controller->shot_packet.weapon = WeaponIdPistol;
+    controller->shot_packet.damage_class = weapon_get_stats(WeaponIdPistol)->damage_class;
+    infrared_timings_pool_init(
+        &controller->timings_pool, controller->shot_timings, COUNT_OF(controller->shot_timings));
+    memset(controller->tx_current_ma, 0, sizeof(controller->tx_current_ma));
+    memset(controller->tx_current_samples, 0, sizeof(controller->tx_current_samples));
     controller->notification = furi_record_open(RECORD_NOTIFICATION);
-    controller->hit_received = false;
-    controller->processing_signal = false;
-
-    if(controller->worker && controller->signal && controller->notification) {
-        FURI_LOG_I(
+    controller->worker_rx_active = false;
+    controller->rx_enabled = false;
+    controller->ir_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    controller->tx_pending = 0;
+    controller->ack_request = 0;
+    controller->beacon_request = 0;
+    controller->beacon_epoch = 0;
+    controller->cs_deferrals = 0;
+    controller->cs_forced = 0;
+    controller->rx_garbled = 0;
+    controller->rx_recovered = 0;
+    controller->raw_decoding = false;
+    controller->tx_request_cycles = 0;
+    controller->tx_address = 0;
+    controller->tx_command = 0;
+    controller->tx_end_tick = 0;
+    controller->tx_active = false;
+    controller->round_start_tick = furi_get_tick();
+    controller->shot_encoded = false;
+    hit_queue_reset(&controller->hits);
+    controller->hit_event_pending = false;
+    controller->hit_callback = NULL;
+    controller->hit_callback_context = NULL;
+    controller->board_attached = false;
+    controller->board_timer = furi_timer_alloc(
+        infrared_controller_board_timer_callback, FuriTimerTypePeriodic, controller);
+    controller->tx_thread = furi_thread_alloc_ex(
+        "IrTxScheduler", INFRARED_CONTROLLER_TX_STACK_SIZE, infrared_controller_tx_thread, controller);
+
+    // Nothing has been started or powered yet, so a failure only has to give memory back.
+    if(controller->worker && signals_allocated && controller->notification &&
+       controller->ir_mutex && controller->board_timer && controller->tx_thread) {
+        LASER_TAG_LOG_I(
             TAG, "InfraredWorker, InfraredSignal, and NotificationApp allocated successfully");
     } else {
         FURI_LOG_E(TAG, "Failed to allocate resources");
-        free(controller);
+        infrared_controller_unwind(controller);
         return NULL;
     }
 
-    FURI_LOG_I(TAG, "Setting up RX callback");
+    LASER_TAG_LOG_I(TAG, "Setting up RX callback");
     infrared_worker_rx_set_received_signal_callback(
         controller->worker, infrared_rx_callback, controller);
 
-    FURI_LOG_I(TAG, "InfraredController allocated successfully");
+    infrared_controller_set_player(controller, 0, LASER_TAG_PACKET_TEAM_NONE);
+
+    // Route and power the TX pin up front so the very first shot leaves on the right output.
+    infrared_controller_poll_board(controller);
+
+    furi_thread_start(controller->tx_thread);
+    furi_timer_start(
+        controller->board_timer, furi_ms_to_ticks(INFRARED_CONTROLLER_BOARD_POLL_MS));
+
+    LASER_TAG_LOG_I(TAG, "InfraredController allocated successfully");
     return controller;
 }
 
 void infrared_controller_free(InfraredController* controller) {
-    FURI_LOG_I(TAG, "Freeing InfraredController");
+    LASER_TAG_LOG_I(TAG, "Freeing InfraredController");
 
     if(controller) {
+        furi_timer_stop(controller->board_timer);
+        furi_timer_free(controller->board_timer);
+
+        LASER_TAG_LOG_I(TAG, "Stopping TX scheduler");
+        furi_thread_flags_set(
+            furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventExit);
+        furi_thread_join(controller->tx_thread);
+        furi_thread_free(controller->tx_thread);
+
         if(controller->worker_rx_active) {
-            FURI_LOG_I(TAG, "Stopping RX worker");
+            LASER_TAG_LOG_I(TAG, "Stopping RX worker");
             infrared_worker_rx_stop(controller->worker);
         }
 
-        FURI_LOG_I(TAG, "Freeing InfraredWorker and InfraredSignal");
+        if(controller->board_attached) {
+            LASER_TAG_LOG_I(TAG, "Powering down external infrared board");
+            infrared_setup_external_board(false);
+        }
+
+        LASER_TAG_LOG_I(TAG, "Freeing InfraredWorker and InfraredSignal");
         infrared_worker_free(controller->worker);
-        infrared_signal_free(controller->signal);
+        for(size_t i = 0; i < WeaponIdCount; i++) {
+            infrared_signal_free(controller->shots[i].signal);
+        }
+        furi_mutex_free(controller->ir_mutex);
 
-        FURI_LOG_I(TAG, "Closing NotificationApp");
+        LASER_TAG_LOG_I(TAG, "Closing NotificationApp");
         furi_record_close(RECORD_NOTIFICATION);
 
-        free(controller);
-
-        FURI_LOG_I(TAG, "InfraredController freed successfully");
+        LASER_TAG_LOG_I(TAG, "InfraredController freed successfully");
     } else {
         FURI_LOG_W(TAG, "Attempted to free NULL InfraredController");
     }
 }
 
+void infrared_controller_rearm(InfraredController* controller) {
+    furi_assert(controller);
+    // The TX thread and the RX callback keep counting while we read, so take and restart each.
+    uint32_t cs_deferrals = __atomic_exchange_n(&controller->cs_deferrals, 0, __ATOMIC_RELAXED);
+    uint32_t cs_forced = __atomic_exchange_n(&controller->cs_forced, 0, __ATOMIC_RELAXED);
+    uint32_t rx_garbled = __atomic_exchange_n(&controller->rx_garbled, 0, __ATOMIC_RELAXED);
+    uint32_t rx_recovered = __atomic_exchange_n(&controller->rx_recovered, 0, __ATOMIC_RELAXED);
+    LASER_TAG_LOG_I(
+        TAG,
+        "Rearming InfraredController, last round: %lu backoffs, %lu forced, %lu garbled, "
+        "%lu recovered, %lu dropped",
+        cs_deferrals,
+        cs_forced,
+        rx_garbled,
+        rx_recovered,
+        hit_queue_get_dropped(&controller->hits));
+
+    // Nothing is torn down: the worker keeps running if it already was, so the receiver is live
+    // as soon as this returns. Hits decoded before this point belong to the previous round.
+    __atomic_store_n(&controller->round_start_tick, furi_get_tick(), __ATOMIC_RELEASE);
+    __atomic_store_n(&controller->hit_event_pending, false, __ATOMIC_RELEASE);
+    hit_queue_flush(&controller->hits);
+
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    __atomic_store_n(&controller->tx_pending, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&controller->ack_request, 0, __ATOMIC_RELEASE);
+    controller->tx_end_tick = 0;
+    controller->rx_enabled = true;
+    infrared_controller_rx_start(controller);
+    furi_mutex_release(controller->ir_mutex);
+}
+
 void infrared_controller_send(InfraredController* controller) {
-    FURI_LOG_I(TAG, "Preparing to send infrared signal");
+    LASER_TAG_LOG_I(TAG, "Scheduling infrared signal");
 
-    InfraredMessage message = {
-        .protocol = InfraredProtocolNEC, .address = 0x42, .command = IR_COMMAND_SHOOT};
+    // Hand the shot to the TX scheduler so the game loop never waits for the
+    // frame to go out or for the receiver to restart.
+    controller->tx_request_cycles = laser_tag_profiler_now();
+    __atomic_add_fetch(&controller->tx_pending, 1, __ATOMIC_ACQ_REL);
+    furi_thread_flags_set(furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventShoot);
+}
 
-    FURI_LOG_I(
-        TAG,
-        "Prepared message: protocol=%d, address=0x%lx, command=0x%lx",
-        message.protocol,
-        (unsigned long)message.address,
-        (unsigned long)message.command);
+void infrared_controller_send_ack(InfraredController* controller, uint8_t shooter_id, bool kill) {
+    furi_assert(controller);
+    furi_assert(shooter_id < LASER_TAG_PACKET_MAX_PLAYERS);
+
+    LaserTagPacket packet = {
+        .kind = LaserTagPacketKindAck,
+        .player_id = shooter_id,
+        .victim_id = controller->shot_packet.player_id,
+        .kill = kill,
+    };
+    uint32_t address, command;
+    laser_tag_packet_encode(&packet, &address, &command);
+
+    // Only the latest ACK is kept. A victim can be damaged at most once per invulnerability
+    // window, so this also caps every player at about one ACK per second.
+    uint32_t request = (1UL << 31) | (address << 8) | command;
+    __atomic_store_n(&controller->ack_request, request, __ATOMIC_RELEASE);
+    furi_thread_flags_set(furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventAck);
+}
 
-    if(controller->worker_rx_active) {
-        FURI_LOG_I(TAG, "Stopping RX worker");
-        infrared_worker_rx_stop(controller->worker);
-        controller->worker_rx_active = false;
-    }
+static void infrared_controller_request_beacon(
+    InfraredController* controller,
+    LaserTagPacketBeacon beacon,
+    uint16_t value) {
+    // Like ACKs, only the latest beacon is kept; a referee sends them well apart.
+    uint32_t request = (1UL << 31) | ((uint32_t)beacon << 16) |
+                       (value & LASER_TAG_PACKET_BEACON_VALUE_MASK);
+    __atomic_store_n(&controller->beacon_request, request, __ATOMIC_RELEASE);
+    furi_thread_flags_set(
+        furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventBeacon);
+}
 
-    FURI_LOG_I(TAG, "Setting message for infrared signal");
-    infrared_signal_set_message(controller->signal, &message);
+void infrared_controller_send_beacon(
+    InfraredController* controller,
+    LaserTagPacketBeacon beacon,
+    uint16_t match_id) {
+    furi_assert(controller);
+    furi_assert(beacon == LaserTagPacketBeaconStart || beacon == LaserTagPacketBeaconStop);
+    infrared_controller_request_beacon(controller, beacon, match_id);
+}
 
-    FURI_LOG_I(TAG, "Starting infrared signal transmission");
-    infrared_signal_transmit(controller->signal);
+void infrared_controller_send_sync(InfraredController* controller, uint32_t epoch_tick) {
+    furi_assert(controller);
+    __atomic_store_n(&controller->beacon_epoch, epoch_tick, __ATOMIC_RELEASE);
+    infrared_controller_request_beacon(controller, LaserTagPacketBeaconSync, 0);
+}
 
-    if(!controller->worker_rx_active) {
-        infrared_worker_rx_start(controller->worker);
-        controller->worker_rx_active = true;
+bool infrared_controller_is_tx_busy(InfraredController* controller) {
+    furi_assert(controller);
+    return __atomic_load_n(&controller->tx_pending, __ATOMIC_ACQUIRE) > 0 ||
+           __atomic_load_n(&controller->tx_active, __ATOMIC_ACQUIRE);
+}
+
+void infrared_controller_set_player(
+    InfraredController* controller,
+    uint8_t player_id,
+    uint8_t team_id) {
+    furi_assert(controller);
+    furi_assert(player_id < LASER_TAG_PACKET_MAX_PLAYERS);
+    furi_assert(team_id < LASER_TAG_PACKET_MAX_TEAMS);
+
+    // Rounds usually restart with the same player; keep the weapon set we already have.
+    if(controller->shot_encoded && controller->shot_packet.player_id == player_id &&
+       controller->shot_packet.team_id == team_id) {
+        return;
     }
 
-    FURI_LOG_I(TAG, "Infrared signal transmission completed");
+    // The TX scheduler reads the cached waveforms under the same lock.
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->shot_packet.kind = LaserTagPacketKindShoot;
+    controller->shot_packet.player_id = player_id;
+    controller->shot_packet.team_id = team_id;
+    infrared_controller_encode_weapon_set(controller);
+    controller->shot_encoded = true;
+    furi_mutex_release(controller->ir_mutex);
+
+    LASER_TAG_LOG_I(TAG, "Player %d on team %d", player_id, team_id);
 }
 
-bool infrared_controller_receive(InfraredController* controller) {
-    FURI_LOG_I(TAG, "Starting infrared signal reception");
+void infrared_controller_set_weapon(
+    InfraredController* controller,
+    uint8_t weapon,
+    const InfraredSignal* preset) {
+    furi_assert(controller);
+    furi_assert(weapon < WeaponIdCount);
 
-    if(controller->processing_signal) {
-        FURI_LOG_W(TAG, "Cannot start reception, another signal is still being processed");
-        return false;
-    }
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->shot_packet.weapon = weapon;
+    controller->shot_packet.damage_class = weapon_get_stats(weapon)->damage_class;
+    controller->shot_preset = preset;
+    furi_mutex_release(controller->ir_mutex);
 
-    if(!controller->worker_rx_active) {
-        infrared_worker_rx_start(controller->worker);
-        controller->worker_rx_active = true;
-        furi_delay_ms(250);
+    LASER_TAG_LOG_I(TAG, "Weapon %d%s", weapon, preset ? ", from a preset" : "");
+}
+
+size_t infrared_controller_receive(
+    InfraredController* controller,
+    HitRecord* hits,
+    size_t max_count) {
+    LASER_TAG_LOG_I(TAG, "Starting infrared signal reception");
+
+    // Clear before draining so a hit pushed meanwhile raises a new event.
+    __atomic_store_n(&controller->hit_event_pending, false, __ATOMIC_RELEASE);
+    size_t count = hit_queue_drain(&controller->hits, hits, max_count);
+
+    // Drop stragglers that were being decoded while the round was rearmed.
+    uint32_t round_start = __atomic_load_n(&controller->round_start_tick, __ATOMIC_ACQUIRE);
+    size_t kept = 0;
+    for(size_t i = 0; i < count; i++) {
+        if((int32_t)(hits[i].tick - round_start) >= 0) {
+            hits[kept++] = hits[i];
+        }
     }
+    count = kept;
 
-    bool hit = controller->hit_received;
+    LASER_TAG_LOG_I(TAG, "Signal reception complete, hits received: %zu", count);
 
-    FURI_LOG_I(TAG, "Signal reception complete, hit received: %s", hit ? "true" : "false");
+    return count;
+}
+
+void infrared_controller_set_raw_decoding(InfraredController* controller, bool enable) {
+    furi_assert(controller);
+    controller->raw_decoding = enable;
+    LASER_TAG_LOG_I(TAG, "Raw decoding %s", enable ? "enabled" : "disabled");
+}
+
+void infrared_controller_set_hit_callback(
+    InfraredController* controller,
+    InfraredControllerHitCallback callback,
+    void* context) {
+    furi_assert(controller);
+    controller->hit_callback = callback;
+    controller->hit_callback_context = context;
+}
 
-    controller->hit_received = false;
+void infrared_controller_set_tx_profile(
+    InfraredController* controller,
+    InfraredControllerTxProfile profile) {
+    furi_assert(controller);
+    furi_assert(profile < InfraredControllerTxProfileCount);
+    // Picked up by the next shot; the views only change carrier, nothing is encoded again.
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->tx_profile = profile;
+    infrared_controller_apply_tx_profile(controller);
+    furi_mutex_release(controller->ir_mutex);
+    LASER_TAG_LOG_I(TAG, "TX profile %s", infrared_controller_tx_profiles[profile].name);
+}
+
+const char* infrared_controller_get_tx_profile_name(InfraredControllerTxProfile profile) {
+    furi_assert(profile < InfraredControllerTxProfileCount);
+    return infrared_controller_tx_profiles[profile].name;
+}
 
-    return hit;
+bool infrared_controller_get_tx_current(
+    InfraredController* controller,
+    InfraredControllerTxProfile profile,
+    int32_t* milliamps) {
+    furi_assert(controller);
+    furi_assert(profile < InfraredControllerTxProfileCount);
+    if(controller->tx_current_samples[profile] == 0) return false;
+    *milliamps = controller->tx_current_ma[profile];
+    return true;
 }
 
 void infrared_controller_pause(InfraredController* controller) {
-    if(controller->worker_rx_active) {
-        FURI_LOG_I(TAG, "Stopping RX worker");
-        infrared_worker_rx_stop(controller->worker);
-        controller->worker_rx_active = false;
-    }
+    LASER_TAG_LOG_I(TAG, "Stopping RX worker");
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->rx_enabled = false;
+    infrared_controller_rx_stop(controller);
+    furi_mutex_release(controller->ir_mutex);
 }
 
 void infrared_controller_resume(InfraredController* controller) {
-    if(!controller->worker_rx_active) {
-        FURI_LOG_I(TAG, "Starting RX worker");
-        infrared_worker_rx_start(controller->worker);
-        controller->worker_rx_active = true;
+    LASER_TAG_LOG_I(TAG, "Starting RX worker");
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->rx_enabled = true;
+    infrared_controller_rx_start(controller);
+    furi_mutex_release(controller->ir_mutex);
+}
+
+void infrared_controller_park(InfraredController* controller) {
+    furi_assert(controller);
+    LASER_TAG_LOG_I(TAG, "Parking InfraredController");
+    furi_timer_stop(controller->board_timer);
+
+    // Same lock as the board poll, so the TX thread is never probing PA7 meanwhile.
+    furi_check(furi_mutex_acquire(controller->ir_mutex, FuriWaitForever) == FuriStatusOk);
+    controller->rx_enabled = false;
+    infrared_controller_rx_stop(controller);
+    if(controller->board_attached) {
+        // OTG is the largest drain while idle; the next poll finds the board again.
+        controller->board_attached = false;
+        infrared_setup_external_board(false);
     }
+    furi_mutex_release(controller->ir_mutex);
+}
+
+void infrared_controller_unpark(InfraredController* controller) {
+    furi_assert(controller);
+    LASER_TAG_LOG_I(TAG, "Unparking InfraredController");
+    furi_timer_start(
+        controller->board_timer, furi_ms_to_ticks(INFRARED_CONTROLLER_BOARD_POLL_MS));
+    furi_thread_flags_set(
+        furi_thread_get_id(controller->tx_thread), InfraredControllerTxEventBoard);
 }
@@ -4,23 +4,157 @@
 #include <notification/notification.h>
 #include <infrared_worker.h>
 #include <infrared_signal.h>
+#include <furi_hal_infrared.h>
 #include "game_state.h"
+#include "hit_queue.h"
+#include "weapon.h"
+
+typedef void (*InfraredControllerHitCallback)(void* context);
+
+/** Raw timings in one of our NEC frames: leader, 32 bits and the final mark. */
+#define INFRARED_CONTROLLER_FRAME_TIMINGS 67
+
+/** Size of the shot timings pool, enough for the whole weapon set. */
+#define INFRARED_CONTROLLER_SHOT_TIMINGS_MAX (INFRARED_CONTROLLER_FRAME_TIMINGS * WeaponIdCount)
+
+/** Carrier settings for our shots, from least to most range. */
+typedef enum {
+    InfraredControllerTxProfileClose, /**< Detuned, low duty: fewer stray hits indoors. */
+    InfraredControllerTxProfileStandard, /**< NEC defaults. */
+    InfraredControllerTxProfileLong, /**< Wide duty cycle for open fields, costs battery. */
+    InfraredControllerTxProfileCount,
+} InfraredControllerTxProfile;
+
+/** One weapon's shot for the current player and team, encoded once per loadout. */
+typedef struct {
+    InfraredMessage message; /**< The frame, for the echo check and as the encoder fallback. */
+    InfraredSignal* signal; /**< View into timings_pool with the TX profile's carrier. */
+    const uint32_t* timings; /**< Start of the view, NULL if the frame could not be encoded. */
+    size_t timings_size;
+} InfraredControllerShot;
 
 typedef struct InfraredController {
     InfraredWorker* worker;
     bool worker_rx_active;
-    InfraredSignal* signal;
+    bool rx_enabled;
+    FuriMutex* ir_mutex;
+    FuriThread* tx_thread;
+    uint32_t tx_pending;
+    uint32_t ack_request;
+    uint32_t beacon_request;
+    uint32_t beacon_epoch; /**< Tick the referee's match clock counts from. */
+    uint32_t tx_request_cycles;
+    uint32_t tx_address;
+    uint32_t tx_command;
+    uint32_t tx_end_tick;
+    bool tx_active; /**< A frame is waiting for the channel or on air. */
+    // Round counters: bumped atomically by the TX thread or the RX callback, taken and
+    // restarted by infrared_controller_rearm().
+    uint32_t cs_deferrals; /**< Backoffs taken because the channel was busy. */
+    uint32_t cs_forced; /**< Frames sent on a busy channel after the last backoff. */
+    uint32_t rx_garbled; /**< Frames the decoder could not make sense of. */
+    uint32_t rx_recovered; /**< Frames the stock decoder rejected but the raw decoder saved. */
+    bool raw_decoding;
+    uint32_t round_start_tick;
+    LaserTagPacket shot_packet; /**< Player, team and the weapon picked from shots. */
+    bool shot_encoded; /**< shots hold the weapon set for shot_packet's player and team. */
+    InfraredControllerShot shots[WeaponIdCount];
+    const InfraredSignal* shot_preset; /**< Sent instead of the weapon's shot; caller owns it. */
+    InfraredTimingsPool timings_pool;
+    uint32_t shot_timings[INFRARED_CONTROLLER_SHOT_TIMINGS_MAX];
+    InfraredControllerTxProfile tx_profile;
+    int32_t tx_current_ma[InfraredControllerTxProfileCount]; /**< Moving average draw. */
+    uint32_t tx_current_samples[InfraredControllerTxProfileCount];
     NotificationApp* notification;
-    bool hit_received;
-    bool processing_signal;
+    HitQueue hits;
+    bool hit_event_pending;
+    InfraredControllerHitCallback hit_callback;
+    void* hit_callback_context;
+    FuriTimer* board_timer;
+    bool board_attached; /**< External IR board on PA7 detected and powered over OTG. */
 } InfraredController;
 
 InfraredController* infrared_controller_alloc();
 void infrared_controller_free(InfraredController* controller);
+void infrared_controller_rearm(InfraredController* controller);
 void infrared_controller_send(InfraredController* controller);
-bool infrared_controller_receive(InfraredController* controller);
-void update_infrared_board_status(InfraredController* controller);
+void infrared_controller_send_ack(InfraredController* controller, uint8_t shooter_id, bool kill);
+/** Start and stop beacons carry the match id. They go out without the ACK's random delay. */
+void infrared_controller_send_beacon(
+    InfraredController* controller,
+    LaserTagPacketBeacon beacon,
+    uint16_t match_id);
+/**
+ * Sync beacon with the match clock counted from epoch_tick. The clock is read once carrier sense
+ * has let the frame through and is stamped for the end of the frame.
+ */
+void infrared_controller_send_sync(InfraredController* controller, uint32_t epoch_tick);
+/** True while a shot is queued or any frame is on air, so a new shot would only wait. */
+bool infrared_controller_is_tx_busy(InfraredController* controller);
+size_t infrared_controller_receive(
+    InfraredController* controller,
+    HitRecord* hits,
+    size_t max_count);
+void infrared_controller_set_raw_decoding(InfraredController* controller, bool enable);
+void infrared_controller_set_hit_callback(
+    InfraredController* controller,
+    InfraredControllerHitCallback callback,
+    void* context);
+/**
+ * Encodes every weapon's shot for this player and team into the timings pool. Does nothing if
+ * the set is already encoded for them, so calling it every round is cheap.
+ */
+void infrared_controller_set_player(
+    InfraredController* controller,
+    uint8_t player_id,
+    uint8_t team_id);
+/**
+ * Picks the weapon's pre-encoded shot for the next frames; never encodes. A preset, e.g. from
+ * an InfraredSignalLibrary, goes out as it is instead, with its own carrier whatever the TX
+ * profile. It must stay valid until the next call or until the controller is freed.
+ */
+void infrared_controller_set_weapon(
+    InfraredController* controller,
+    uint8_t weapon,
+    const InfraredSignal* preset);
+void infrared_controller_set_tx_profile(
+    InfraredController* controller,
+    InfraredControllerTxProfile profile);
+const char* infrared_controller_get_tx_profile_name(InfraredControllerTxProfile profile);
+bool infrared_controller_get_tx_current(
+    InfraredController* controller,
+    InfraredControllerTxProfile profile,
+    int32_t* milliamps);
 void infrared_controller_pause(InfraredController* controller);
 void infrared_controller_resume(InfraredController* controller);
+/**
+ * Between rounds: RX off, board polling stopped and an external board powered down. A frame
+ * still queued goes out from the internal LED. unpark() probes the board again; rearm() turns
+ * RX back on.
+ */
+void infrared_controller_park(InfraredController* controller);
+void infrared_controller_unpark(InfraredController* controller);
+
+/**
+ * Battery draw is read from the fuel gauge right after each shot and averaged per profile with
+ * weight 1/2^SHIFT. It is the whole unit's draw, so only compare profiles on the same setup.
+ */
+#define INFRARED_CONTROLLER_TX_CURRENT_SHIFT 3
+
+/** Random delay before an ACK goes out, so victims of one burst do not answer in lockstep. */
+#define INFRARED_CONTROLLER_ACK_DELAY_MIN_MS 5
+#define INFRARED_CONTROLLER_ACK_DELAY_MAX_MS 40
+
+/**
+ * Carrier sense before every transmission. The channel counts as clear once the receiver has
+ * stayed idle for a whole window. The window is longer than any gap inside an NEC frame except
+ * the 4.5 ms leader space, so a frame in progress is nearly always caught. Backoff is in slots;
+ * attempt n waits 1 to 2^(n+1) slots, which worst case adds about 270 ms on a jammed channel.
+ */
+#define INFRARED_CONTROLLER_CS_WINDOW_US    3000
+#define INFRARED_CONTROLLER_CS_SAMPLE_US    50
+#define INFRARED_CONTROLLER_CS_SLOT_US      4000
+#define INFRARED_CONTROLLER_CS_MAX_ATTEMPTS 5
 
-#define IR_COMMAND_SHOOT  0xA1
+/** Frames matching our last shot within this window after it ended are treated as our own echo. */
+#define INFRARED_CONTROLLER_ECHO_WINDOW_MS 30
@@ -28,6 +28,7 @@
 
 struct InfraredSignal {
     bool is_raw;
+    bool owns_timings; /**< Raw timings are our heap copy rather than a view. */
     union {
         InfraredMessage message;
         InfraredRawSignal raw;
@@ -36,7 +37,10 @@ struct InfraredSignal {
 
 static void infrared_signal_clear_timings(InfraredSignal* signal) {
     if(signal->is_raw) {
-        free(signal->payload.raw.timings);
+        if(signal->owns_timings) {
+            free(signal->payload.raw.timings);
+        }
+        signal->owns_timings = false;
         signal->payload.raw.timings_size = 0;
         signal->payload.raw.timings = NULL;
     }
@@ -168,8 +172,9 @@ static inline bool infrared_signal_read_raw(InfraredSignal* signal, FlipperForma
             free(timings);
             break;
         }
-        infrared_signal_set_raw_signal(signal, timings, timings_size, frequency, duty_cycle);
-        free(timings);
+        // The buffer was allocated for this signal anyway; adopt it instead of copying.
+        infrared_signal_set_raw_view(signal, timings, timings_size, frequency, duty_cycle);
+        signal->owns_timings = true;
 
         success = true;
     } while(false);
@@ -205,6 +210,7 @@ InfraredSignal* infrared_signal_alloc() {
     InfraredSignal* signal = malloc(sizeof(InfraredSignal));
 
     signal->is_raw = false;
+    signal->owns_timings = false;
     signal->payload.message.protocol = InfraredProtocolUnknown;
 
     return signal;
@@ -227,8 +233,13 @@ bool infrared_signal_is_valid(const InfraredSignal* signal) {
 void infrared_signal_set_signal(InfraredSignal* signal, const InfraredSignal* other) {
     if(other->is_raw) {
         const InfraredRawSignal* raw = &other->payload.raw;
-        infrared_signal_set_raw_signal(
-            signal, raw->timings, raw->timings_size, raw->frequency, raw->duty_cycle);
+        if(other->owns_timings) {
+            infrared_signal_set_raw_signal(
+                signal, raw->timings, raw->timings_size, raw->frequency, raw->duty_cycle);
+        } else {
+            infrared_signal_set_raw_view(
+                signal, raw->timings, raw->timings_size, raw->frequency, raw->duty_cycle);
+        }
     } else {
         const InfraredMessage* message = &other->payload.message;
         infrared_signal_set_message(signal, message);
@@ -251,6 +262,45 @@ void infrared_signal_set_raw_signal(
 
     signal->payload.raw.timings = malloc(timings_size * sizeof(uint32_t));
     memcpy(signal->payload.raw.timings, timings, timings_size * sizeof(uint32_t));
+    signal->owns_timings = true;
+}
+
+void infrared_signal_set_raw_view(
+    InfraredSignal* signal,
+    const uint32_t* timings,
+    size_t timings_size,
+    uint32_t frequency,
+    float duty_cycle) {
+    infrared_signal_clear_timings(signal);
+
+    signal->is_raw = true;
+    signal->owns_timings = false;
+
+    signal->payload.raw.timings_size = timings_size;
+    signal->payload.raw.frequency = frequency;
+    signal->payload.raw.duty_cycle = duty_cycle;
+    // Never written through while owns_timings is false.
+    signal->payload.raw.timings = (uint32_t*)timings;
+}
+
+void infrared_timings_pool_init(InfraredTimingsPool* pool, uint32_t* storage, size_t capacity) {
+    pool->timings = storage;
+    pool->capacity = capacity;
+    pool->used = 0;
+}
+
+void infrared_timings_pool_reset(InfraredTimingsPool* pool) {
+    pool->used = 0;
+}
+
+uint32_t* infrared_timings_pool_reserve(InfraredTimingsPool* pool, size_t* available) {
+    *available = pool->capacity - pool->used;
+    return &pool->timings[pool->used];
+}
+
+void infrared_timings_pool_commit(InfraredTimingsPool* pool, size_t count) {
+    furi_check(count <= pool->capacity - pool->used);
+    pool->used += count;
 }
 
 const InfraredRawSignal* infrared_signal_get_raw_signal(const InfraredSignal* signal) {
@@ -31,6 +31,57 @@ typedef struct {
     float duty_cycle; /**< Duty cycle of the signal. */
 } InfraredRawSignal;
 
+/**
+ * @brief Shared storage for raw signal timings.
+ *
+ * A pool is one caller-provided array that signals are packed into back to back. Signals set
+ * from a pool only hold a view (a pointer and a length into the array), so they never allocate
+ * and copying them copies the view. Space is only reclaimed by resetting the whole pool, which
+ * invalidates every view into it.
+ */
+typedef struct {
+    uint32_t* timings; /**< Backing array, owned by the caller. */
+    size_t capacity; /**< Number of elements in the backing array. */
+    size_t used; /**< Number of elements handed out so far. */
+} InfraredTimingsPool;
+
+/**
+ * @brief Initialize a timings pool over a caller-provided array.
+ *
+ * @param[out] pool pointer to the pool to be initialized.
+ * @param[in] storage pointer to the backing array, must outlive the pool and every view into it.
+ * @param[in] capacity number of elements in the backing array.
+ */
+void infrared_timings_pool_init(InfraredTimingsPool* pool, uint32_t* storage, size_t capacity);
+
+/**
+ * @brief Empty a timings pool.
+ *
+ * @warning every signal viewing the pool must be reassigned before it is used again.
+ *
+ * @param[in,out] pool pointer to the pool to be reset.
+ */
+void infrared_timings_pool_reset(InfraredTimingsPool* pool);
+
+/**
+ * @brief Get the free tail of a pool to write timings into directly.
+ *
+ * Nothing is handed out until infrared_timings_pool_commit() is called.
+ *
+ * @param[in,out] pool pointer to the pool.
+ * @param[out] available number of elements that may be written.
+ * @returns pointer to the first free element.
+ */
+uint32_t* infrared_timings_pool_reserve(InfraredTimingsPool* pool, size_t* available);
+
+/**
+ * @brief Hand out timings written into the tail returned by infrared_timings_pool_reserve().
+ *
+ * @param[in,out] pool pointer to the pool.
+ * @param[in] count number of elements written, at most the reserved amount.
+ */
+void infrared_timings_pool_commit(InfraredTimingsPool* pool, size_t count);
+
 /**
  * @brief Create a new InfraredSignal instance.
  *
@@ -65,7 +116,8 @@ bool infrared_signal_is_valid(const InfraredSignal* signal);
  * @brief Set an InfraredInstance to hold the signal from another one.
  *
  * Any instance's previous contents will be automatically deleted before
- * copying the source instance's contents.
+ * copying the source instance's contents. A source that views pooled timings is copied by
+ * reference; one that owns its timings is copied deeply.
  *
  * @param[in,out] signal pointer to the destination instance.
  * @param[in] other pointer to the source instance.
@@ -93,6 +145,28 @@ void infrared_signal_set_raw_signal(
     uint32_t frequency,
     float duty_cycle);
 
+/**
+ * @brief Set an InfraredInstance to hold a raw signal without copying its timings.
+ *
+ * The instance only keeps a view of the timings, so this never allocates. Copies made with
+ * infrared_signal_set_signal() share the same view.
+ *
+ * After this call, infrared_signal_is_raw() will return true.
+ *
+ * @param[in,out] signal pointer to the destination instance.
+ * @param[in] timings pointer to the timings, usually in an InfraredTimingsPool. Must outlive the
+ * instance and any copy of it.
+ * @param[in] timings_size number of elements in the timings array.
+ * @param[in] frequency signal carrier frequency, in Hertz.
+ * @param[in] duty_cycle signal duty cycle, fraction between 0 and 1.
+ */
+void infrared_signal_set_raw_view(
+    InfraredSignal* signal,
+    const uint32_t* timings,
+    size_t timings_size,
+    uint32_t frequency,
+    float duty_cycle);
+
 /**
  * @brief Get the raw signal held by an InfraredSignal instance.
  *
@@ -167,6 +241,8 @@ bool infrared_signal_read_body(InfraredSignal* signal, FlipperFormat* ff);
  *
  * This function will look for a signal with the given name and if found, attempt to read it.
  * Same considerations apply as to infrared_signal_read().
+ * The file is scanned from the current position on every call; for repeated lookups load it
+ * into an InfraredSignalLibrary instead.
  *
  * @param[in,out] signal pointer to the instance to be read into.
  * @param[in,out] ff pointer to the FlipperFormat file instance to read from.
@@ -183,6 +259,8 @@ bool infrared_signal_search_by_name_and_read(
  *
  * This function will look for a signal with the given index and if found, attempt to read it.
  * Same considerations apply as to infrared_signal_read().
+ * The file is scanned from the current position on every call; for repeated lookups load it
+ * into an InfraredSignalLibrary instead.
  *
  * @param[in,out] signal pointer to the instance to be read into.
  * @param[in,out] ff pointer to the FlipperFormat file instance to read from.
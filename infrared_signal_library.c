@@ -0,0 +1,169 @@
+#include "infrared_signal_library.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+#include <storage/storage.h>
+#include <flipper_format/flipper_format.h>
+#include <string.h>
+
+#define TAG "InfraredSignalLibrary"
+
+#define INFRARED_SIGNAL_LIBRARY_FILE_TYPE    "IR signals file"
+#define INFRARED_SIGNAL_LIBRARY_FILE_VERSION 1
+
+// Twice the entry count keeps probe chains short; must be a power of two.
+#define INFRARED_SIGNAL_LIBRARY_TABLE_SIZE (INFRARED_SIGNAL_LIBRARY_MAX_SIGNALS * 2)
+#define INFRARED_SIGNAL_LIBRARY_TABLE_MASK (INFRARED_SIGNAL_LIBRARY_TABLE_SIZE - 1)
+
+_Static_assert(
+    (INFRARED_SIGNAL_LIBRARY_TABLE_SIZE & INFRARED_SIGNAL_LIBRARY_TABLE_MASK) == 0,
+    "INFRARED_SIGNAL_LIBRARY_TABLE_SIZE must be a power of two");
+_Static_assert(INFRARED_SIGNAL_LIBRARY_MAX_SIGNALS < UINT8_MAX, "Slots store index + 1");
+
+typedef struct {
+    InfraredSignal* signal;
+    uint32_t hash;
+    char name[INFRARED_SIGNAL_LIBRARY_NAME_SIZE];
+} InfraredSignalLibraryEntry;
+
+struct InfraredSignalLibrary {
+    InfraredSignalLibraryEntry entries[INFRARED_SIGNAL_LIBRARY_MAX_SIGNALS];
+    uint8_t slots[INFRARED_SIGNAL_LIBRARY_TABLE_SIZE]; /**< Entry index + 1, 0 when empty. */
+    size_t count;
+};
+
+static uint32_t infrared_signal_library_hash(const char* name) {
+    // FNV-1a, as for player ids and tags.
+    uint32_t hash = 2166136261UL;
+    for(; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619UL;
+    }
+    return hash;
+}
+
+// Returns the slot holding name, or the empty slot it would go into.
+static size_t infrared_signal_library_probe(
+    const InfraredSignalLibrary* library,
+    const char* name,
+    uint32_t hash) {
+    size_t slot = hash & INFRARED_SIGNAL_LIBRARY_TABLE_MASK;
+    while(library->slots[slot]) {
+        const InfraredSignalLibraryEntry* entry = &library->entries[library->slots[slot] - 1];
+        if(entry->hash == hash && strcmp(entry->name, name) == 0) break;
+        slot = (slot + 1) & INFRARED_SIGNAL_LIBRARY_TABLE_MASK;
+    }
+    return slot;
+}
+
+static void infrared_signal_library_clear(InfraredSignalLibrary* library) {
+    for(size_t i = 0; i < library->count; i++) {
+        infrared_signal_free(library->entries[i].signal);
+        library->entries[i].signal = NULL;
+    }
+    memset(library->slots, 0, sizeof(library->slots));
+    library->count = 0;
+}
+
+InfraredSignalLibrary* infrared_signal_library_alloc() {
+    InfraredSignalLibrary* library = laser_tag_arena_alloc(sizeof(InfraredSignalLibrary));
+    if(!library) {
+        FURI_LOG_E(TAG, "Failed to allocate InfraredSignalLibrary");
+        return NULL;
+    }
+    library->count = 0;
+    return library;
+}
+
+void infrared_signal_library_free(InfraredSignalLibrary* library) {
+    furi_assert(library);
+    // The signals come from the heap; the library itself is arena memory.
+    infrared_signal_library_clear(library);
+}
+
+size_t infrared_signal_library_load(InfraredSignalLibrary* library, const char* path) {
+    furi_assert(library);
+    furi_assert(path);
+    infrared_signal_library_clear(library);
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    FlipperFormat* ff = flipper_format_file_alloc(storage);
+    FuriString* name = furi_string_alloc();
+    InfraredSignal* signal = NULL;
+
+    do {
+        uint32_t version;
+        if(!flipper_format_file_open_existing(ff, path)) {
+            LASER_TAG_LOG_I(TAG, "No presets at %s", path);
+            break;
+        }
+        if(!flipper_format_read_header(ff, name, &version) ||
+           !furi_string_equal(name, INFRARED_SIGNAL_LIBRARY_FILE_TYPE) ||
+           version != INFRARED_SIGNAL_LIBRARY_FILE_VERSION) {
+            FURI_LOG_W(TAG, "%s is not an IR signals file", path);
+            break;
+        }
+
+        // One pass: every body is parsed right after its name and kept.
+        while(library->count < INFRARED_SIGNAL_LIBRARY_MAX_SIGNALS &&
+              infrared_signal_read_name(ff, name)) {
+            if(!signal) signal = infrared_signal_alloc();
+            const char* cname = furi_string_get_cstr(name);
+            if(!infrared_signal_read_body(signal, ff)) {
+                FURI_LOG_W(TAG, "Skipping unreadable signal %s", cname);
+                continue;
+            }
+            if(furi_string_size(name) >= INFRARED_SIGNAL_LIBRARY_NAME_SIZE) {
+                FURI_LOG_W(TAG, "Skipping signal with a long name: %s", cname);
+                continue;
+            }
+
+            uint32_t hash = infrared_signal_library_hash(cname);
+            size_t slot = infrared_signal_library_probe(library, cname, hash);
+            if(library->slots[slot]) {
+                LASER_TAG_LOG_D(TAG, "Ignoring duplicate signal %s", cname);
+                continue;
+            }
+
+            InfraredSignalLibraryEntry* entry = &library->entries[library->count];
+            entry->signal = signal;
+            entry->hash = hash;
+            strlcpy(entry->name, cname, sizeof(entry->name));
+            library->slots[slot] = ++library->count;
+            signal = NULL;
+        }
+    } while(false);
+
+    if(signal) infrared_signal_free(signal);
+    furi_string_free(name);
+    flipper_format_free(ff);
+    furi_record_close(RECORD_STORAGE);
+
+    LASER_TAG_LOG_I(TAG, "Loaded %zu signals from %s", library->count, path);
+    return library->count;
+}
+
+size_t infrared_signal_library_get_count(const InfraredSignalLibrary* library) {
+    furi_assert(library);
+    return library->count;
+}
+
+const InfraredSignal*
+    infrared_signal_library_find(const InfraredSignalLibrary* library, const char* name) {
+    furi_assert(library);
+    furi_assert(name);
+    size_t slot = infrared_signal_library_probe(library, name, infrared_signal_library_hash(name));
+    return library->slots[slot] ? library->entries[library->slots[slot] - 1].signal : NULL;
+}
+
+const InfraredSignal*
+    infrared_signal_library_get(const InfraredSignalLibrary* library, size_t index) {
+    furi_assert(library);
+    furi_assert(index < library->count);
+    return library->entries[index].signal;
+}
+
+const char* infrared_signal_library_get_name(const InfraredSignalLibrary* library, size_t index) {
+    furi_assert(library);
+    furi_assert(index < library->count);
+    return library->entries[index].name;
+}
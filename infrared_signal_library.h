@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+* @file infrared_signal_library.h
+* @brief Signal presets loaded from an .ir file in one pass and looked up by name in O(1).
+* @details infrared_signal_search_by_name_and_read() re-parses the file from the top for every
+* lookup. The library instead parses every entry once at load time and keeps the parsed
+* InfraredSignal. An open addressing table keyed by the FNV-1a hash of the name points at each
+* entry, so switching presets mid-match never touches storage. When a name appears more than
+* once, the first entry wins, as with the linear search.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "infrared_signal.h"
+
+/** Largest number of presets kept; later entries in the file are ignored. */
+#define INFRARED_SIGNAL_LIBRARY_MAX_SIGNALS 16
+
+/** Longest preset name, terminator included; longer names are skipped. */
+#define INFRARED_SIGNAL_LIBRARY_NAME_SIZE 20
+
+typedef struct InfraredSignalLibrary InfraredSignalLibrary;
+
+/**
+ * @brief Allocates an empty library.
+ * @return InfraredSignalLibrary* Pointer to the allocated library, or NULL.
+ */
+InfraredSignalLibrary* infrared_signal_library_alloc();
+
+/**
+ * @brief Frees every loaded signal and the library.
+ * @param library InfraredSignalLibrary to free.
+ */
+void infrared_signal_library_free(InfraredSignalLibrary* library);
+
+/**
+ * @brief Replaces the library's contents with the signals in an .ir file.
+ * @details Entries that fail to parse are skipped; the rest of the file still loads.
+ * @param library InfraredSignalLibrary to load into.
+ * @param path Path to an "IR signals file".
+ * @return Number of signals loaded, 0 if the file is missing or not a signals file.
+ */
+size_t infrared_signal_library_load(InfraredSignalLibrary* library, const char* path);
+
+/**
+ * @brief Returns the number of loaded signals.
+ * @param library InfraredSignalLibrary to query.
+ * @return Signal count.
+ */
+size_t infrared_signal_library_get_count(const InfraredSignalLibrary* library);
+
+/**
+ * @brief Looks a signal up by name.
+ * @param library InfraredSignalLibrary to search.
+ * @param name Signal name as written in the file.
+ * @return The parsed signal, or NULL if there is none by that name.
+ */
+const InfraredSignal*
+    infrared_signal_library_find(const InfraredSignalLibrary* library, const char* name);
+
+/**
+ * @brief Returns a signal by its position in the file, skipped entries not counted.
+ * @param library InfraredSignalLibrary to query.
+ * @param index Index below infrared_signal_library_get_count().
+ * @return The parsed signal.
+ */
+const InfraredSignal*
+    infrared_signal_library_get(const InfraredSignalLibrary* library, size_t index);
+
+/**
+ * @brief Returns the name of a signal by its position.
+ * @param library InfraredSignalLibrary to query.
+ * @param index Index below infrared_signal_library_get_count().
+ * @return Signal name.
+ */
+const char* infrared_signal_library_get_name(const InfraredSignalLibrary* library, size_t index);
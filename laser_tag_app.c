@@ -3,69 +3,316 @@
 #include "infrared_controller.h"
 #include "game_state.h"
 #include "lfrfid_reader.h"
+#include "tag_actions.h"
+#include "shot_tracker.h"
+#include "shot_scheduler.h"
+#include "hit_batch.h"
+#include "weapon.h"
+#include "match_recorder.h"
+#include "infrared_signal_library.h"
+#include "laser_tag_profiler.h"
+#include "frame_scheduler.h"
+#include "timer_wheel.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
 #include <furi.h>
 #include <gui/gui.h>
 #include <input/input.h>
 #include <notification/notification.h>
+#include <furi_hal_version.h>
+#include <furi_hal_random.h>
+#include <storage/storage.h>
+#include <flipper_format/flipper_format.h>
 
 #define TAG "LaserTagApp"
 
+#define LASER_TAG_EVENT_QUEUE_SIZE 16
+#define LASER_TAG_TAG_DATA_SIZE    8
+#define LASER_TAG_SCAN_TIMEOUT_MS  3000
+#define LASER_TAG_MAX_FPS          20
+
+// Confirm hits back to the shooter; see shot_tracker.h for the matching side.
+#define LASER_TAG_SEND_ACKS true
+
+// Retry frames the stock NEC decoder rejects with the tolerant raw decoder.
+#define LASER_TAG_RAW_DECODING true
+
+// A scan alternates between energizing the LF antenna and listening for IR, so
+// hits keep landing while the player holds a tag to the back of the device.
+#define LASER_TAG_SCAN_RFID_WINDOW_MS 400
+#define LASER_TAG_SCAN_IR_WINDOW_MS   100
+
+// Weapon and team signal presets, read once at startup. A preset named after a weapon, or
+// "Team <n> <weapon>" for one team only, is sent instead of our own shot for that weapon.
+#define LASER_TAG_PRESETS_PATH      APP_DATA_PATH("presets.ir")
+#define LASER_TAG_PRESET_NAME_SIZE INFRARED_SIGNAL_LIBRARY_NAME_SIZE
+
+// The player id picked on the splash screen, kept across launches. Without one the id is
+// derived from the MCU UID, which two units in a group can share.
+#define LASER_TAG_SETTINGS_PATH         APP_DATA_PATH("settings.conf")
+#define LASER_TAG_SETTINGS_FILE_TYPE    "Laser Tag Settings"
+#define LASER_TAG_SETTINGS_FILE_VERSION 1
+#define LASER_TAG_SETTINGS_PLAYER_KEY   "Player"
+
+// Splash and game over screens dim the backlight after this long without input.
+#define LASER_TAG_IDLE_DIM_MS 30000
+
+// A referee repeats start and stop for units that missed the first one, then keeps clocks in line
+// with sync beacons. A unit caught by the last start is a second late until the first sync, well
+// inside the two seconds a sync can correct.
+#define LASER_TAG_BEACON_REPEATS   3
+#define LASER_TAG_BEACON_REPEAT_MS 500
+#define LASER_TAG_BEACON_SYNC_MS   5000
+
+typedef enum {
+    LaserTagEventTypeInput,
+    LaserTagEventTypeHit,
+    LaserTagEventTypeTagRead,
+    LaserTagEventTypeTick,
+    LaserTagEventTypeFrame,
+} LaserTagEventType;
+
+/** Game events run off the timer wheel; one wakeup timer covers all of them. */
+typedef enum {
+    LaserTagTimerClock, /**< Next whole second of game time. */
+    LaserTagTimerFire, /**< Next shot or end of reload. */
+    LaserTagTimerScan, /**< End of the current scan window. */
+    LaserTagTimerIdle, /**< Backlight dim on idle screens. */
+    LaserTagTimerBeacon, /**< Referee's next beacon. */
+    LaserTagTimerCount,
+} LaserTagTimer;
+
+_Static_assert(LaserTagTimerCount <= TIMER_WHEEL_MAX_TIMERS, "Too many game timers");
+
+typedef struct {
+    LaserTagEventType type;
+    uint32_t cycles;
+    union {
+        InputEvent input;
+        struct {
+            uint8_t data[LASER_TAG_TAG_DATA_SIZE];
+            uint8_t length;
+            uint8_t protocol;
+        } tag;
+    };
+} LaserTagEvent;
+
 struct LaserTagApp {
     Gui* gui;
     ViewPort* view_port;
     LaserTagView* view;
     FuriMessageQueue* event_queue;
-    FuriTimer* timer;
+    FuriTimer* timer; /**< One-shot wakeup for the wheel's earliest deadline. */
+    TimerWheel* timers;
+    uint32_t timers_due; /**< Bit per LaserTagTimer expired by the last advance. */
+    uint32_t clock_tick; /**< Tick the game clock was last advanced to. */
     NotificationApp* notifications;
     InfraredController* ir_controller;
     GameState* game_state;
     LaserTagState state;
-    bool need_redraw;
+    FrameScheduler* frame_scheduler;
     LFRFIDReader* reader;
+    TagActions* tag_actions;
+    ShotTracker* shot_tracker;
+    ShotScheduler* shot_scheduler;
+    bool idle; /**< Between rounds, with timers stopped and IR parked. */
+    bool dimmed;
+    MatchRecorder* recorder;
+    InfraredSignalLibrary* presets;
+    uint8_t tag_protocols[LFRFID_READER_MAX_PROTOCOLS];
+    uint8_t player_id;
+    bool player_id_changed; /**< Picked on the splash screen and not saved yet. */
+    uint8_t team_id;
+    InfraredControllerTxProfile tx_profile;
+    uint32_t input_cycles; /**< Stamp of the input being handled, 0 outside of one. */
+    bool scanning;
+    bool scan_antenna_on;
+    uint32_t scan_deadline;
+    uint16_t match_id; /**< Refereed match we play in or run, 0 for none. */
+    bool match_stopped; /**< The referee ended our round. */
+    bool referee_live; /**< Refereeing: a match is running. */
+    uint8_t beacon_repeats; /**< Refereeing: start or stop beacons still to send. */
+    uint32_t match_epoch; /**< Refereeing: tick the match clock counts from. */
+    uint32_t syncs_sent;
 };
 
-const NotificationSequence sequence_vibro_1 = {&message_vibro_on, &message_vibro_off, NULL};
+const NotificationSequence sequence_hit = {
+    &message_vibro_on,
+    &message_note_d4,
+    &message_delay_1000,
+    &message_vibro_off,
+    &message_sound_off,
+    NULL,
+};
 const NotificationSequence sequence_short_beep =
     {&message_note_c4, &message_delay_50, &message_sound_off, NULL};
 
+// Scaled by the user's brightness setting like every other backlight message.
+static const NotificationMessage message_display_backlight_dim = {
+    .type = NotificationMessageTypeLedDisplayBacklight,
+    .data.led.value = 0x20,
+};
+static const NotificationSequence sequence_display_backlight_dim = {
+    &message_display_backlight_dim,
+    NULL,
+};
+
+static void laser_tag_app_post_event(LaserTagApp* app, const LaserTagEvent* event) {
+    if(furi_message_queue_put(app->event_queue, event, 0) != FuriStatusOk) {
+        FURI_LOG_W(TAG, "Event queue full, dropping event type=%d", event->type);
+    }
+}
+
 static void laser_tag_app_timer_callback(void* context) {
     furi_assert(context);
     LaserTagApp* app = context;
-    FURI_LOG_D(TAG, "Timer callback triggered");
+    LASER_TAG_LOG_D(TAG, "Timer callback triggered");
 
-    if(app->state == LaserTagStateGame) {
-        FURI_LOG_D(TAG, "Updating game time by 1 second");
-        game_state_update_time(app->game_state, 1);
-    }
+    LaserTagEvent event = {.type = LaserTagEventTypeTick};
+    laser_tag_app_post_event(app, &event);
+}
+
+static void laser_tag_app_input_callback(InputEvent* input_event, void* context) {
+    furi_assert(context);
+    LaserTagApp* app = context;
+    LASER_TAG_LOG_D(TAG, "Input event received: type=%d, key=%d", input_event->type, input_event->key);
+    LaserTagEvent event = {
+        .type = LaserTagEventTypeInput,
+        .cycles = laser_tag_profiler_now(),
+        .input = *input_event,
+    };
+    laser_tag_app_post_event(app, &event);
+}
+
+static void laser_tag_app_frame_callback(void* context) {
+    furi_assert(context);
+    LaserTagApp* app = context;
+    LaserTagEvent event = {.type = LaserTagEventTypeFrame};
+    laser_tag_app_post_event(app, &event);
+}
 
-    if(app->view) {
-        FURI_LOG_D(TAG, "Updating view with the latest game state");
-        laser_tag_view_update(app->view, app->game_state);
-        app->need_redraw = true;
+// Runs inside timer_wheel_advance() on the game loop; the handlers run once it returns.
+static void laser_tag_app_timer_expired(void* context, uint8_t id) {
+    LaserTagApp* app = context;
+    app->timers_due |= 1UL << id;
+}
+
+static void laser_tag_app_schedule(LaserTagApp* app, LaserTagTimer timer, uint32_t delay) {
+    timer_wheel_schedule(app->timers, timer, furi_get_tick(), delay);
+}
+
+static void laser_tag_app_arm_timer(LaserTagApp* app) {
+    uint32_t wait = timer_wheel_get_wait(app->timers, furi_get_tick());
+    if(wait == TIMER_WHEEL_WAIT_FOREVER) {
+        if(furi_timer_is_running(app->timer)) furi_timer_stop(app->timer);
+    } else {
+        furi_timer_start(app->timer, MAX(wait, 1UL));
     }
 }
 
-static void laser_tag_app_input_callback(InputEvent* input_event, void* context) {
+// Game time follows the tick counter, so late or merged events never make it drift.
+static void laser_tag_app_advance_clock(LaserTagApp* app) {
+    if(app->state != LaserTagStateGame) return;
+    uint32_t frequency = furi_kernel_get_tick_frequency();
+    uint32_t elapsed_ms = (furi_get_tick() - app->clock_tick) * 1000 / frequency;
+    if(elapsed_ms == 0) return;
+    app->clock_tick += elapsed_ms * frequency / 1000;
+    GameStateUpdate update = {.elapsed_ms = elapsed_ms};
+    game_state_apply(app->game_state, &update);
+}
+
+static void laser_tag_app_schedule_clock(LaserTagApp* app) {
+    uint32_t time_ms = game_state_get_time_ms(app->game_state);
+    laser_tag_app_schedule(app, LaserTagTimerClock, furi_ms_to_ticks(1000 - time_ms % 1000));
+}
+
+static void laser_tag_app_hit_callback(void* context) {
     furi_assert(context);
     LaserTagApp* app = context;
-    FURI_LOG_D(TAG, "Input event received: type=%d, key=%d", input_event->type, input_event->key);
-    furi_message_queue_put(app->event_queue, input_event, 0);
-    FURI_LOG_D(TAG, "Input event queued successfully");
+    LaserTagEvent event = {.type = LaserTagEventTypeHit};
+    laser_tag_app_post_event(app, &event);
+}
+
+static void laser_tag_app_draw_debug(Canvas* canvas) {
+    canvas_clear(canvas);
+    canvas_set_font(canvas, FontSecondary);
+
+    char line[32];
+    for(uint8_t span = 0; span < LaserTagProfilerSpanCount; span++) {
+        const LaserTagProfilerHistogram* histogram = laser_tag_profiler_get(span);
+        uint8_t y = span * 16;
+        uint32_t mean_us = histogram->count ? histogram->sum_us / histogram->count : 0;
+
+        snprintf(line, sizeof(line), "%s avg %luus", laser_tag_profiler_get_name(span), mean_us);
+        canvas_draw_str(canvas, 0, y + 7, line);
+        snprintf(line, sizeof(line), "max %luus n=%lu", histogram->max_us, histogram->count);
+        canvas_draw_str(canvas, 48, y + 15, line);
+
+        // One bar per bucket, scaled to the fullest bucket.
+        uint16_t peak = 1;
+        for(uint8_t bucket = 0; bucket < LASER_TAG_PROFILER_BUCKETS; bucket++) {
+            if(histogram->buckets[bucket] > peak) peak = histogram->buckets[bucket];
+        }
+        for(uint8_t bucket = 0; bucket < LASER_TAG_PROFILER_BUCKETS; bucket++) {
+            uint8_t height = (histogram->buckets[bucket] * 6 + peak - 1) / peak;
+            canvas_draw_box(canvas, bucket * 4, y + 15 - height, 3, height);
+        }
+        canvas_draw_line(canvas, 0, y + 15, 43, y + 15);
+    }
+}
+
+static void laser_tag_app_draw_referee(Canvas* canvas, LaserTagApp* app) {
+    canvas_clear(canvas);
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 64, 14, AlignCenter, AlignCenter, "REFEREE");
+    canvas_set_font(canvas, FontSecondary);
+
+    char line[32];
+    if(app->referee_live) {
+        snprintf(line, sizeof(line), "Match %03X running", app->match_id);
+        canvas_draw_str_aligned(canvas, 64, 30, AlignCenter, AlignCenter, line);
+        snprintf(line, sizeof(line), "%lu clock syncs sent", app->syncs_sent);
+        canvas_draw_str_aligned(canvas, 64, 40, AlignCenter, AlignCenter, line);
+        canvas_draw_str_aligned(canvas, 64, 58, AlignCenter, AlignBottom, "OK to stop the match");
+    } else if(app->beacon_repeats > 0) {
+        snprintf(line, sizeof(line), "Stopping match %03X", app->match_id);
+        canvas_draw_str_aligned(canvas, 64, 35, AlignCenter, AlignCenter, line);
+    } else {
+        canvas_draw_str_aligned(canvas, 64, 30, AlignCenter, AlignCenter, "Point at the players");
+        canvas_draw_str_aligned(canvas, 64, 40, AlignCenter, AlignCenter, "OK to start a match");
+        canvas_draw_str_aligned(canvas, 64, 58, AlignCenter, AlignBottom, "Back to leave");
+    }
+    canvas_draw_frame(canvas, 0, 0, 128, 64);
 }
 
 static void laser_tag_app_draw_callback(Canvas* canvas, void* context) {
     furi_assert(context);
     LaserTagApp* app = context;
-    FURI_LOG_D(TAG, "Entering draw callback");
+    LASER_TAG_LOG_D(TAG, "Entering draw callback");
 
     if(app->state == LaserTagStateSplashScreen) {
         canvas_clear(canvas);
         canvas_set_font(canvas, FontPrimary);
         canvas_draw_str(canvas, 5, 20, "Laser Tag: Free4All!");
         canvas_set_font(canvas, FontSecondary);
-        canvas_draw_str(canvas, 5, 40, "https://github.com/");
-        canvas_draw_str(canvas, 5, 50, "otomir23/");
-        canvas_draw_str(canvas, 5, 60, "Laser-Tag-Free4All");
+        canvas_draw_str(canvas, 5, 40, "github.com/otomir23/");
+        canvas_draw_str(canvas, 5, 50, "Laser-Tag-Free4All");
+
+        // Our player id, so a group can spot and fix two units that picked the same one.
+        char line[32];
+        snprintf(line, sizeof(line), "P%02d", app->player_id);
+        canvas_draw_str_aligned(canvas, 123, 50, AlignRight, AlignBottom, line);
+
+        // Range profile, with the draw measured while it was last used.
+        int32_t milliamps;
+        const char* profile = infrared_controller_get_tx_profile_name(app->tx_profile);
+        if(app->ir_controller &&
+           infrared_controller_get_tx_current(app->ir_controller, app->tx_profile, &milliamps)) {
+            snprintf(line, sizeof(line), "< %s %ldmA >", profile, milliamps);
+        } else {
+            snprintf(line, sizeof(line), "< Range: %s >", profile);
+        }
+        canvas_draw_str_aligned(canvas, 64, 60, AlignCenter, AlignBottom, line);
         canvas_draw_frame(canvas, 0, 0, 128, 64);
         canvas_draw_line(canvas, 0, 30, 127, 30);
 
@@ -74,8 +321,39 @@ static void laser_tag_app_draw_callback(Canvas* canvas, void* context) {
 
         canvas_set_font(canvas, FontPrimary);
 
-        // Display "GAME OVER!" centered on the screen
-        canvas_draw_str_aligned(canvas, 64, 25, AlignCenter, AlignCenter, "GAME OVER!");
+        // Display "GAME OVER!" centered on the screen, or "MATCH OVER" if the referee ended it
+        const char* title = app->match_stopped ? "MATCH OVER" : "GAME OVER!";
+        canvas_draw_str_aligned(canvas, 64, 14, AlignCenter, AlignCenter, title);
+        canvas_set_font(canvas, FontSecondary);
+
+        char line[32];
+        int16_t killer = game_state_get_last_hit_by(app->game_state);
+        if(killer != GAME_STATE_NO_PLAYER) {
+            snprintf(line, sizeof(line), "Tagged by P%02d", killer);
+            canvas_draw_str_aligned(canvas, 64, 24, AlignCenter, AlignCenter, line);
+        }
+
+        const ShotTrackerStats* stats = shot_tracker_get_stats(app->shot_tracker);
+        snprintf(
+            line,
+            sizeof(line),
+            "Acc %u%% %lu/%lu K:%lu",
+            shot_tracker_get_accuracy(app->shot_tracker),
+            stats->hits,
+            stats->shots,
+            stats->kills);
+        canvas_draw_str_aligned(canvas, 64, 33, AlignCenter, AlignCenter, line);
+
+        // Kill feed, most recent first.
+        size_t length = 0;
+        int16_t victim;
+        for(uint8_t i = 0; (victim = shot_tracker_get_kill(app->shot_tracker, i)) >= 0; i++) {
+            length += snprintf(
+                line + length, sizeof(line) - length, "%sP%02d", i ? " " : "Out: ", victim);
+        }
+        if(length > 0) {
+            canvas_draw_str_aligned(canvas, 64, 42, AlignCenter, AlignCenter, line);
+        }
 
         // Add a solid block border around the screen
         for(int x = 0; x < 128; x += 8) {
@@ -87,111 +365,266 @@ static void laser_tag_app_draw_callback(Canvas* canvas, void* context) {
             canvas_draw_box(canvas, 120, y, 8, 8);
         }
 
+        canvas_draw_str_aligned(canvas, 64, 51, AlignCenter, AlignCenter, "Press OK to Restart");
+
+    } else if(app->state == LaserTagStateDebug) {
+        laser_tag_app_draw_debug(canvas);
+
+    } else if(app->state == LaserTagStateWaiting) {
+        canvas_clear(canvas);
+        canvas_set_font(canvas, FontPrimary);
+        canvas_draw_str_aligned(canvas, 64, 14, AlignCenter, AlignCenter, "STAND BY");
         canvas_set_font(canvas, FontSecondary);
-        canvas_draw_str_aligned(canvas, 64, 50, AlignCenter, AlignCenter, "Press OK to Restart");
+        canvas_draw_str_aligned(canvas, 64, 30, AlignCenter, AlignCenter, "Waiting for the");
+        canvas_draw_str_aligned(canvas, 64, 40, AlignCenter, AlignCenter, "referee to start");
+        canvas_draw_str_aligned(canvas, 64, 58, AlignCenter, AlignBottom, "Back to cancel");
+        canvas_draw_frame(canvas, 0, 0, 128, 64);
+
+    } else if(app->state == LaserTagStateReferee) {
+        laser_tag_app_draw_referee(canvas, app);
 
     } else if(app->view) {
-        FURI_LOG_D(TAG, "Drawing game view");
+        LASER_TAG_LOG_D(TAG, "Drawing game view");
         laser_tag_view_draw(laser_tag_view_get_view(app->view), canvas);
     }
-    FURI_LOG_D(TAG, "Exiting draw callback");
+    LASER_TAG_LOG_D(TAG, "Exiting draw callback");
 }
 
-static void tag_callback(uint8_t* data, uint8_t length, void* context) {
+static void tag_callback(uint8_t protocol, uint8_t* data, uint8_t length, void* context) {
     LaserTagApp* app = (LaserTagApp*)context;
 
-    if(length != 5) {
+    // Runs on the reader thread: hand the tag over to the game loop instead of
+    // touching the game state from here.
+    if(length > LASER_TAG_TAG_DATA_SIZE) {
         FURI_LOG_W(TAG, "Tag is not for game.  Length: %d", length);
         return;
     }
 
-    if(data[0] != 0x13 || data[1] != 0x37) {
-        FURI_LOG_D(
-            TAG,
-            "Tag is not for game.  Data: %02x %02x %02x %02x %02x",
-            data[0],
-            data[1],
-            data[2],
-            data[3],
-            data[4]);
-        return;
+    LaserTagEvent event = {.type = LaserTagEventTypeTagRead};
+    memcpy(event.tag.data, data, length);
+    event.tag.length = length;
+    event.tag.protocol = app->tag_protocols[protocol];
+    laser_tag_app_post_event(app, &event);
+}
+
+static bool laser_tag_app_handle_tag(
+    LaserTagApp* app,
+    uint8_t protocol,
+    const uint8_t* data,
+    uint8_t length) {
+    if(app->state != LaserTagStateGame) {
+        LASER_TAG_LOG_D(TAG, "Ignoring tag read outside of the game");
+        return false;
+    }
+
+    TagActionResult result = tag_actions_apply(
+        app->tag_actions, app->game_state, protocol, data, length, furi_get_tick());
+
+    // Opcode and argument sit in the last four bytes on every supported layout.
+    uint32_t tail = 0;
+    for(uint8_t i = length > 4 ? length - 4 : 0; i < length; i++) {
+        tail = (tail << 8) | data[i];
+    }
+    match_recorder_log(
+        app->recorder, app->game_state, MatchRecordTypePickup, protocol, result, tail);
+    if(result == TagActionResultNotGameTag) {
+        LASER_TAG_LOG_D(TAG, "Tag is not for game.  Length: %d", length);
+    } else if(result == TagActionResultCoolingDown) {
+        LASER_TAG_LOG_D(TAG, "Pickup is cooling down");
+    }
+    return result == TagActionResultApplied;
+}
+
+static uint8_t laser_tag_app_player_id_from_uid(void) {
+    // FNV-1a over the MCU UID gives every unit a stable default id without any setup.
+    const uint8_t* uid = furi_hal_version_uid();
+    uint32_t hash = 2166136261UL;
+    for(size_t i = 0; i < furi_hal_version_uid_size(); i++) {
+        hash = (hash ^ uid[i]) * 16777619UL;
     }
+    return (hash ^ (hash >> 16)) % LASER_TAG_PACKET_MAX_PLAYERS;
+}
 
-    if(data[3] == 0xFD) {
-        uint16_t max_delta_ammo = data[4];
-        uint16_t ammo = game_state_get_ammo(app->game_state);
-        uint16_t delta_ammo = INITIAL_AMMO - ammo;
-        if(delta_ammo > max_delta_ammo) {
-            delta_ammo = max_delta_ammo;
+// Falls back to the UID default when there is no settings file or it is unreadable.
+static uint8_t laser_tag_app_load_player_id(void) {
+    uint8_t player_id = laser_tag_app_player_id_from_uid();
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    FlipperFormat* ff = flipper_format_file_alloc(storage);
+    FuriString* type = furi_string_alloc();
+
+    do {
+        uint32_t version;
+        uint32_t value;
+        if(!flipper_format_file_open_existing(ff, LASER_TAG_SETTINGS_PATH)) break;
+        if(!flipper_format_read_header(ff, type, &version) ||
+           !furi_string_equal(type, LASER_TAG_SETTINGS_FILE_TYPE) ||
+           version != LASER_TAG_SETTINGS_FILE_VERSION) {
+            FURI_LOG_W(TAG, "Ignoring unknown settings file");
+            break;
+        }
+        if(!flipper_format_read_uint32(ff, LASER_TAG_SETTINGS_PLAYER_KEY, &value, 1) ||
+           value >= LASER_TAG_PACKET_MAX_PLAYERS) {
+            FURI_LOG_W(TAG, "Ignoring bad player id in settings");
+            break;
         }
-        game_state_increase_ammo(app->game_state, delta_ammo);
-        FURI_LOG_D(TAG, "Increased ammo by: %d", delta_ammo);
+        player_id = value;
+    } while(false);
+
+    furi_string_free(type);
+    flipper_format_free(ff);
+    furi_record_close(RECORD_STORAGE);
+    return player_id;
+}
+
+static void laser_tag_app_save_player_id(LaserTagApp* app) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    FlipperFormat* ff = flipper_format_file_alloc(storage);
+    uint32_t value = app->player_id;
+
+    if(flipper_format_file_open_always(ff, LASER_TAG_SETTINGS_PATH) &&
+       flipper_format_write_header_cstr(
+           ff, LASER_TAG_SETTINGS_FILE_TYPE, LASER_TAG_SETTINGS_FILE_VERSION) &&
+       flipper_format_write_uint32(ff, LASER_TAG_SETTINGS_PLAYER_KEY, &value, 1)) {
+        app->player_id_changed = false;
+        LASER_TAG_LOG_I(TAG, "Saved player id P%02d", app->player_id);
     } else {
-        FURI_LOG_W(TAG, "Tag action unknown: %02x %02x", data[3], data[4]);
+        FURI_LOG_W(TAG, "Failed to save settings");
+    }
+
+    flipper_format_free(ff);
+    furi_record_close(RECORD_STORAGE);
+}
+
+static void laser_tag_app_touch_idle(LaserTagApp* app) {
+    if(!app->idle) return;
+    // Any key press lights the display back up through the notification service.
+    app->dimmed = false;
+    laser_tag_app_schedule(app, LaserTagTimerIdle, furi_ms_to_ticks(LASER_TAG_IDLE_DIM_MS));
+}
+
+// Only a round, or waiting for or running one, needs the receiver and the board; the rest idles.
+static void laser_tag_app_update_idle(LaserTagApp* app) {
+    bool idle = app->state != LaserTagStateGame && app->state != LaserTagStateWaiting &&
+                app->state != LaserTagStateReferee;
+    if(idle == app->idle) return;
+    app->idle = idle;
+
+    if(idle) {
+        LASER_TAG_LOG_I(TAG, "Idling until the next round");
+        timer_wheel_cancel(app->timers, LaserTagTimerClock);
+        timer_wheel_cancel(app->timers, LaserTagTimerFire);
+        timer_wheel_cancel(app->timers, LaserTagTimerBeacon);
+        if(app->ir_controller) infrared_controller_park(app->ir_controller);
+        laser_tag_app_touch_idle(app);
+    } else {
+        LASER_TAG_LOG_I(TAG, "Leaving idle");
+        timer_wheel_cancel(app->timers, LaserTagTimerIdle);
+        if(app->dimmed) {
+            notification_message(app->notifications, &sequence_display_backlight_on);
+            app->dimmed = false;
+        }
+        if(app->ir_controller) infrared_controller_unpark(app->ir_controller);
     }
 }
 
 LaserTagApp* laser_tag_app_alloc() {
-    FURI_LOG_D(TAG, "Allocating Laser Tag App");
-    LaserTagApp* app = malloc(sizeof(LaserTagApp));
+    LASER_TAG_LOG_D(TAG, "Allocating Laser Tag App");
+    LaserTagApp* app = laser_tag_arena_alloc(sizeof(LaserTagApp));
     if(!app) {
         FURI_LOG_E(TAG, "Failed to allocate LaserTagApp");
         return NULL;
     }
-    FURI_LOG_I(TAG, "LaserTagApp allocated successfully");
-
-    memset(app, 0, sizeof(LaserTagApp));
+    LASER_TAG_LOG_I(TAG, "LaserTagApp allocated successfully");
 
     app->gui = furi_record_open(RECORD_GUI);
     app->view_port = view_port_alloc();
     app->view = laser_tag_view_alloc();
     app->notifications = furi_record_open(RECORD_NOTIFICATION);
     app->game_state = game_state_alloc();
-    app->event_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
+    app->event_queue =
+        furi_message_queue_alloc(LASER_TAG_EVENT_QUEUE_SIZE, sizeof(LaserTagEvent));
+    app->frame_scheduler =
+        frame_scheduler_alloc(LASER_TAG_MAX_FPS, laser_tag_app_frame_callback, app);
 
     if(!app->gui || !app->view_port || !app->view || !app->notifications || !app->game_state ||
-       !app->event_queue) {
+       !app->event_queue || !app->frame_scheduler) {
         FURI_LOG_E(TAG, "Failed to allocate resources for LaserTagApp");
         laser_tag_app_free(app);
         return NULL;
     }
 
     app->state = LaserTagStateSplashScreen;
-    app->need_redraw = true;
-    FURI_LOG_I(TAG, "Initial state set to SplashScreen");
+    frame_scheduler_request(app->frame_scheduler);
+    app->player_id = laser_tag_app_load_player_id();
+    app->team_id = LASER_TAG_PACKET_TEAM_NONE;
+    app->tx_profile = InfraredControllerTxProfileStandard;
+    LASER_TAG_LOG_I(TAG, "Playing as P%02d", app->player_id);
+    LASER_TAG_LOG_I(TAG, "Initial state set to SplashScreen");
 
     view_port_draw_callback_set(app->view_port, laser_tag_app_draw_callback, app);
     view_port_input_callback_set(app->view_port, laser_tag_app_input_callback, app);
     gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
-    FURI_LOG_D(TAG, "ViewPort callbacks set and added to GUI");
+    LASER_TAG_LOG_D(TAG, "ViewPort callbacks set and added to GUI");
 
-    app->timer = furi_timer_alloc(laser_tag_app_timer_callback, FuriTimerTypePeriodic, app);
-    if(!app->timer) {
+    app->timer = furi_timer_alloc(laser_tag_app_timer_callback, FuriTimerTypeOnce, app);
+    app->timers = timer_wheel_alloc(laser_tag_app_timer_expired, app);
+    if(!app->timer || !app->timers) {
         FURI_LOG_E(TAG, "Failed to allocate timer");
         laser_tag_app_free(app);
         return NULL;
     }
-    FURI_LOG_I(TAG, "Timer allocated");
+    LASER_TAG_LOG_I(TAG, "Timer allocated");
+
+    app->tag_actions = tag_actions_alloc();
+    app->shot_tracker = shot_tracker_alloc();
+    app->shot_scheduler = shot_scheduler_alloc();
+    app->recorder = match_recorder_alloc();
+    app->presets = infrared_signal_library_alloc();
+    if(!app->tag_actions || !app->shot_tracker || !app->shot_scheduler || !app->recorder ||
+       !app->presets) {
+        laser_tag_app_free(app);
+        return NULL;
+    }
+    infrared_signal_library_load(app->presets, LASER_TAG_PRESETS_PATH);
 
+    // Reader indices only count the protocols it accepted, so map them back to ours.
     app->reader = lfrfid_reader_alloc();
-    lfrfid_reader_set_tag_callback(app->reader, "EM4100", tag_callback, app);
+    for(size_t i = 0; i < tag_actions_get_protocol_count(); i++) {
+        uint8_t index = lfrfid_reader_add_protocol(app->reader, tag_actions_get_protocol_name(i));
+        if(index != LFRFID_READER_PROTOCOL_NONE) {
+            app->tag_protocols[index] = i;
+        }
+    }
+    lfrfid_reader_set_tag_callback(app->reader, tag_callback, app);
+
+    // The splash screen is idle; the game clock starts with the first round.
+    app->idle = false;
+    app->dimmed = false;
+    laser_tag_app_update_idle(app);
+    laser_tag_app_arm_timer(app);
 
-    furi_timer_start(app->timer, furi_kernel_get_tick_frequency());
-    FURI_LOG_D(TAG, "Timer started");
+    LASER_TAG_LOG_I(
+        TAG, "Arena: %zu of %d bytes used", laser_tag_arena_get_used(), LASER_TAG_ARENA_SIZE);
 
     return app;
 }
 
 void laser_tag_app_free(LaserTagApp* app) {
-    FURI_LOG_D(TAG, "Freeing Laser Tag App");
+    LASER_TAG_LOG_D(TAG, "Freeing Laser Tag App");
     furi_assert(app);
 
-    furi_timer_free(app->timer);
+    if(app->timer) {
+        furi_timer_free(app->timer);
+    }
     view_port_enabled_set(app->view_port, false);
     gui_remove_view_port(app->gui, app->view_port);
     view_port_free(app->view_port);
     laser_tag_view_free(app->view);
     furi_message_queue_free(app->event_queue);
+    frame_scheduler_free(app->frame_scheduler);
+    if(app->player_id_changed) {
+        laser_tag_app_save_player_id(app);
+    }
     if(app->ir_controller) {
         infrared_controller_free(app->ir_controller);
     }
@@ -199,211 +632,714 @@ void laser_tag_app_free(LaserTagApp* app) {
         lfrfid_reader_free(app->reader);
         app->reader = NULL;
     }
-    free(app->game_state);
+    if(app->tag_actions) {
+        tag_actions_free(app->tag_actions);
+    }
+    if(app->recorder) {
+        match_recorder_free(app->recorder);
+    }
+    // After the controller, which may still have been pointing at a preset.
+    if(app->presets) {
+        infrared_signal_library_free(app->presets);
+    }
     furi_record_close(RECORD_GUI);
     furi_record_close(RECORD_NOTIFICATION);
 
-    free(app);
-    FURI_LOG_I(TAG, "Laser Tag App freed successfully");
+    // The app itself and all subsystem state live in the arena.
+    laser_tag_arena_reset();
+    LASER_TAG_LOG_I(TAG, "Laser Tag App freed successfully");
 }
 
-void laser_tag_app_fire(LaserTagApp* app) {
+bool laser_tag_app_fire(LaserTagApp* app) {
     furi_assert(app);
-    FURI_LOG_D(TAG, "Firing laser");
+    LASER_TAG_LOG_D(TAG, "Firing laser");
+    // Only the shot fired straight from a trigger press has an input to measure from; auto and
+    // burst follow-ups come off the fire timer.
+    if(app->input_cycles) {
+        laser_tag_profiler_record(LaserTagProfilerSpanInputToFire, app->input_cycles);
+        app->input_cycles = 0;
+    }
 
     if(!app->ir_controller) {
         FURI_LOG_E(TAG, "IR controller is NULL in laser_tag_app_fire");
-        return;
+        return false;
     }
 
-    if(app->ir_controller->processing_signal) {
-        FURI_LOG_W(TAG, "Cannot fire, hit is being processed");
-        return;
+    if(game_state_get_ammo(app->game_state) == 0) {
+        LASER_TAG_LOG_D(TAG, "Cannot fire, out of ammo");
+        return false;
+    }
+
+    if(game_state_is_invulnerable(app->game_state, furi_get_tick())) {
+        FURI_LOG_W(TAG, "Cannot fire, still recovering from a hit");
+        return false;
+    }
+
+    // LF reading and IR transmit share the carrier timer.
+    if(app->scanning) {
+        FURI_LOG_W(TAG, "Cannot fire while scanning for a tag");
+        return false;
     }
 
     infrared_controller_send(app->ir_controller);
-    FURI_LOG_D(TAG, "Laser fired, decreasing ammo by 1");
-    game_state_decrease_ammo(app->game_state, 1);
+    shot_tracker_record_shot(app->shot_tracker, furi_get_tick());
+    LASER_TAG_LOG_D(TAG, "Laser fired, decreasing ammo by 1");
+    GameStateUpdate update = {.ammo_used = 1};
+    game_state_apply(app->game_state, &update);
+    match_recorder_log(
+        app->recorder,
+        app->game_state,
+        MatchRecordTypeShot,
+        app->player_id,
+        shot_scheduler_get_weapon(app->shot_scheduler),
+        0);
 
     notification_message(app->notifications, &sequence_short_beep);
 
     notification_message(app->notifications, &sequence_blink_white_100);
-    FURI_LOG_I(TAG, "Notifying user with blink white and short beep");
+    LASER_TAG_LOG_I(TAG, "Notifying user with blink white and short beep");
+    return true;
+}
 
-    app->need_redraw = true;
+// Takes every shot or reload the scheduler has due, then sleeps until the next one.
+static void laser_tag_app_run_weapon(LaserTagApp* app) {
+    timer_wheel_cancel(app->timers, LaserTagTimerFire);
+    if(app->state != LaserTagStateGame || !app->ir_controller) {
+        shot_scheduler_cancel(app->shot_scheduler);
+        return;
+    }
+
+    ShotSchedulerAction action;
+    uint32_t wait;
+    while((action = shot_scheduler_poll(
+               app->shot_scheduler,
+               furi_get_tick(),
+               infrared_controller_is_tx_busy(app->ir_controller),
+               &wait)) != ShotSchedulerActionNone) {
+        if(action == ShotSchedulerActionFire) {
+            // A trigger held through a failed shot does not keep trying.
+            if(!laser_tag_app_fire(app)) shot_scheduler_cancel(app->shot_scheduler);
+        } else {
+            LASER_TAG_LOG_I(TAG, "Reloaded");
+            GameStateUpdate update = {.ammo_gained = INITIAL_AMMO};
+            game_state_apply(app->game_state, &update);
+            frame_scheduler_request(app->frame_scheduler);
+        }
+    }
+    // The scheduler owns the reload, so the indicator follows it rather than our key presses.
+    laser_tag_view_set_reloading(app->view, shot_scheduler_is_reloading(app->shot_scheduler));
+
+    if(wait != SHOT_SCHEDULER_WAIT_FOREVER) {
+        laser_tag_app_schedule(app, LaserTagTimerFire, wait);
+    }
 }
 
-void laser_tag_app_handle_hit(LaserTagApp* app) {
-    furi_assert(app);
-    FURI_LOG_D(TAG, "Handling hit, decreasing health by 10");
+// A team's own preset wins over the one for everybody; NULL means our own frame.
+static const InfraredSignal* laser_tag_app_find_preset(LaserTagApp* app, const char* weapon) {
+    const InfraredSignal* preset = NULL;
+    if(app->team_id != LASER_TAG_PACKET_TEAM_NONE) {
+        char name[LASER_TAG_PRESET_NAME_SIZE];
+        snprintf(name, sizeof(name), "Team %u %s", (unsigned)app->team_id, weapon);
+        preset = infrared_signal_library_find(app->presets, name);
+    }
+    return preset ? preset : infrared_signal_library_find(app->presets, weapon);
+}
 
-    game_state_decrease_health(app->game_state, 10);
-    notification_message(app->notifications, &sequence_vibro_1);
-    FURI_LOG_I(TAG, "Notifying user with vibration");
+static void laser_tag_app_select_weapon(LaserTagApp* app, uint8_t weapon) {
+    const WeaponStats* stats = weapon_get_stats(weapon);
+    shot_scheduler_set_weapon(app->shot_scheduler, weapon);
+    laser_tag_view_set_weapon(app->view, stats->name);
+    if(app->ir_controller) {
+        infrared_controller_set_weapon(
+            app->ir_controller, weapon, laser_tag_app_find_preset(app, stats->name));
+    }
+    frame_scheduler_request(app->frame_scheduler);
+}
 
-    if(game_state_is_game_over(app->game_state)) {
-        FURI_LOG_I(TAG, "Game over, switching to Game Over screen");
+static void laser_tag_app_log_sync(LaserTagApp* app, LaserTagPacketBeacon beacon) {
+    match_recorder_log(
+        app->recorder,
+        app->game_state,
+        MatchRecordTypeSync,
+        0,
+        beacon,
+        game_state_get_time_ms(app->game_state));
+}
 
-        notification_message(app->notifications, &sequence_error);
+static void laser_tag_app_handle_beacon(LaserTagApp* app, const HitRecord* record) {
+    // A round started on the unit itself answers to no referee.
+    if(app->match_id == 0) return;
 
-        app->state = LaserTagStateGameOver;
-        app->need_redraw = true;
+    const LaserTagPacket* packet = &record->packet;
+    if(packet->beacon == LaserTagPacketBeaconSync) {
+        // Our clock when the frame ended, next to the referee's at the same moment. The game
+        // clock was brought up to clock_tick on the way in; the beacon may be a little older.
+        uint32_t frequency = furi_kernel_get_tick_frequency();
+        uint32_t now_ms = game_state_get_time_ms(app->game_state);
+        int32_t age_ms = (int32_t)(app->clock_tick - record->tick) * 1000 / (int32_t)frequency;
+        int32_t offset = laser_tag_packet_get_sync_offset(packet, now_ms - age_ms);
+        if(offset != 0) {
+            uint32_t aligned_ms = offset < 0 && (uint32_t)-offset > now_ms ? 0 : now_ms + offset;
+            game_state_set_time_ms(app->game_state, aligned_ms);
+            laser_tag_app_schedule_clock(app);
+        }
+        laser_tag_app_log_sync(app, LaserTagPacketBeaconSync);
+        LASER_TAG_LOG_I(TAG, "Clock synced to the referee, off by %ld ms", offset);
+    } else if(
+        packet->beacon == LaserTagPacketBeaconStop && packet->beacon_value == app->match_id) {
+        LASER_TAG_LOG_I(TAG, "Match %03X stopped by the referee", app->match_id);
+        app->match_stopped = true;
+        game_state_set_game_over(app->game_state, true);
     }
 }
 
-static bool laser_tag_app_enter_game_state(LaserTagApp* app) {
+void laser_tag_app_handle_hits(LaserTagApp* app, const HitRecord* hits, size_t count) {
     furi_assert(app);
-    FURI_LOG_I(TAG, "Entering game state");
+    furi_assert(hits);
+    furi_assert(count <= HIT_QUEUE_SIZE);
 
-    app->state = LaserTagStateGame;
-    game_state_reset(app->game_state);
-    FURI_LOG_D(TAG, "Game state reset");
+    // Confirmations of our own shots and referee beacons share the queue with incoming shots.
+    HitBatch batch;
+    hit_batch_build(&batch, hits, count);
+    for(size_t i = 0; i < batch.beacon_count; i++) {
+        laser_tag_app_handle_beacon(app, &hits[batch.beacons[i]]);
+    }
+    for(size_t i = 0; i < batch.ack_count; i++) {
+        const HitRecord* ack = &hits[batch.acks[i]];
+        bool matched = shot_tracker_match_ack(
+            app->shot_tracker, ack->tick, ack->packet.victim_id, ack->packet.kill);
+        if(matched && ack->packet.kill) {
+            notification_message(app->notifications, &sequence_success);
+        }
+        match_recorder_log(
+            app->recorder,
+            app->game_state,
+            MatchRecordTypeConfirm,
+            ack->packet.victim_id,
+            ack->packet.kill,
+            matched);
+    }
+    if(batch.hit_count == 0) return;
 
-    laser_tag_view_update(app->view, app->game_state);
-    FURI_LOG_D(TAG, "View updated with new game state");
+    for(size_t i = 0; i < batch.hit_count; i++) {
+        laser_tag_profiler_record(LaserTagProfilerSpanRxToHit, hits[batch.shots[i]].cycles);
+    }
+    bool hurt = hit_batch_apply(&batch, app->game_state);
+    LASER_TAG_LOG_D(TAG, "Applied %zu hits, %zu landed", batch.hit_count, batch.landed);
 
-    if(app->ir_controller) {
-        infrared_controller_free(app->ir_controller);
-        app->ir_controller = NULL;
+    for(size_t i = 0; i < batch.hit_count; i++) {
+        match_recorder_log(
+            app->recorder,
+            app->game_state,
+            MatchRecordTypeHit,
+            batch.hits[i].player_id,
+            batch.hits[i].damage,
+            hurt);
+    }
+
+    // Hits soaked up by invulnerability change nothing and are not worth a buzz, or an ACK.
+    if(hurt) {
+        // Asynchronous: the notification service plays it while we keep running.
+        notification_message(app->notifications, &sequence_hit);
+        LASER_TAG_LOG_I(TAG, "Notifying user with vibration");
+
+        if(LASER_TAG_SEND_ACKS && app->ir_controller) {
+            infrared_controller_send_ack(
+                app->ir_controller,
+                game_state_get_last_hit_by(app->game_state),
+                game_state_is_game_over(app->game_state));
+        }
     }
+}
+
+// The controller is allocated for the first round, or the first beacon, and kept afterwards.
+static bool laser_tag_app_ensure_controller(LaserTagApp* app) {
+    if(app->ir_controller) return true;
+
     app->ir_controller = infrared_controller_alloc();
     if(!app->ir_controller) {
         FURI_LOG_E(TAG, "Failed to allocate IR controller");
         return false;
     }
-    FURI_LOG_I(TAG, "IR controller allocated");
-    app->need_redraw = true;
+    LASER_TAG_LOG_I(TAG, "IR controller allocated");
+    infrared_controller_set_hit_callback(app->ir_controller, laser_tag_app_hit_callback, app);
+    infrared_controller_set_raw_decoding(app->ir_controller, LASER_TAG_RAW_DECODING);
+    return true;
+}
+
+static bool laser_tag_app_enter_game_state(LaserTagApp* app, uint16_t match_id) {
+    furi_assert(app);
+    LASER_TAG_LOG_I(TAG, "Entering game state");
+
+    app->state = LaserTagStateGame;
+    app->match_id = match_id;
+    app->match_stopped = false;
+    game_state_reset(app->game_state);
+    app->clock_tick = furi_get_tick();
+    laser_tag_app_schedule_clock(app);
+    tag_actions_reset(app->tag_actions);
+    shot_tracker_reset(app->shot_tracker);
+    shot_scheduler_reset(app->shot_scheduler);
+    laser_tag_view_set_reloading(app->view, shot_scheduler_is_reloading(app->shot_scheduler));
+    match_recorder_start(app->recorder, app->player_id, app->team_id, match_id);
+    match_recorder_log(
+        app->recorder, app->game_state, MatchRecordTypeState, app->player_id, app->state, 0);
+    LASER_TAG_LOG_D(TAG, "Game state reset");
+
+    laser_tag_view_update(app->view, app->game_state);
+    LASER_TAG_LOG_D(TAG, "View updated with new game state");
+
+    if(!laser_tag_app_ensure_controller(app)) return false;
+    infrared_controller_set_player(app->ir_controller, app->player_id, app->team_id);
+    laser_tag_app_select_weapon(app, shot_scheduler_get_weapon(app->shot_scheduler));
+    infrared_controller_set_tx_profile(app->ir_controller, app->tx_profile);
+    infrared_controller_rearm(app->ir_controller);
+
+    frame_scheduler_request(app->frame_scheduler);
+    return true;
+}
+
+static void laser_tag_app_check_game_over(LaserTagApp* app) {
+    if(app->state == LaserTagStateGame && game_state_is_game_over(app->game_state)) {
+        LASER_TAG_LOG_I(TAG, "Game over, notifying user with error sequence");
+        notification_message(app->notifications, &sequence_error);
+        // Stop game logic after game over
+        app->state = LaserTagStateGameOver;
+        match_recorder_log(
+            app->recorder,
+            app->game_state,
+            MatchRecordTypeState,
+            game_state_get_last_hit_by(app->game_state),
+            app->state,
+            0);
+        match_recorder_stop(app->recorder);
+        frame_scheduler_request(app->frame_scheduler);
+    }
+}
+
+static bool laser_tag_app_enter_waiting(LaserTagApp* app) {
+    if(!laser_tag_app_ensure_controller(app)) return false;
+    LASER_TAG_LOG_I(TAG, "Waiting for a referee");
+    app->state = LaserTagStateWaiting;
+    infrared_controller_rearm(app->ir_controller);
+    frame_scheduler_request(app->frame_scheduler);
+    return true;
+}
+
+// Until a refereed match starts, only its start beacon matters.
+static void laser_tag_app_wait_for_start(LaserTagApp* app) {
+    HitRecord hits[HIT_QUEUE_SIZE];
+    size_t count;
+    while((count = infrared_controller_receive(app->ir_controller, hits, COUNT_OF(hits))) > 0) {
+        for(size_t i = 0; i < count; i++) {
+            const LaserTagPacket* packet = &hits[i].packet;
+            if(packet->kind != LaserTagPacketKindBeacon ||
+               packet->beacon != LaserTagPacketBeaconStart) {
+                continue;
+            }
+
+            LASER_TAG_LOG_I(TAG, "Match %03X started by the referee", packet->beacon_value);
+            if(!laser_tag_app_enter_game_state(app, packet->beacon_value)) return;
+            // The match started when the frame was received, not when we got round to it.
+            app->clock_tick = hits[i].tick;
+            laser_tag_app_advance_clock(app);
+            laser_tag_app_schedule_clock(app);
+            laser_tag_app_log_sync(app, LaserTagPacketBeaconStart);
+            return;
+        }
+    }
+}
+
+static void laser_tag_app_drain_hits(LaserTagApp* app) {
+    if(!app->ir_controller) return;
+    if(app->state == LaserTagStateWaiting) {
+        laser_tag_app_wait_for_start(app);
+        return;
+    }
+    if(app->state != LaserTagStateGame) return;
+
+    // Drain everything queued since the last event so bursts are all counted, one batch
+    // per queue's worth.
+    HitRecord hits[HIT_QUEUE_SIZE];
+    size_t count;
+    while(!game_state_is_game_over(app->game_state) &&
+          (count = infrared_controller_receive(app->ir_controller, hits, COUNT_OF(hits))) > 0) {
+        laser_tag_app_handle_hits(app, hits, count);
+    }
+    laser_tag_app_check_game_over(app);
+}
+
+static void laser_tag_app_handle_clock(LaserTagApp* app) {
+    if(app->state != LaserTagStateGame) return;
+
+    // The clock itself advanced on the way in; this only lands on the next whole second.
+    laser_tag_app_schedule_clock(app);
+    // Safety net in case a hit event could not be queued.
+    laser_tag_app_drain_hits(app);
+}
+
+static void laser_tag_app_sync_view(LaserTagApp* app) {
+    // Only a change in a visible field is worth a frame.
+    if(app->state == LaserTagStateGame && app->view &&
+       laser_tag_view_update(app->view, app->game_state) != 0) {
+        LASER_TAG_LOG_D(TAG, "View updated with the latest game state");
+        frame_scheduler_request(app->frame_scheduler);
+    }
+}
+
+static void laser_tag_app_commit_frame(LaserTagApp* app) {
+    laser_tag_app_sync_view(app);
+    if(frame_scheduler_commit(app->frame_scheduler)) {
+        LASER_TAG_LOG_D(TAG, "Updating viewport");
+        view_port_update(app->view_port);
+    }
+}
+
+static void laser_tag_app_scan_set_antenna(LaserTagApp* app, bool on) {
+    if(on == app->scan_antenna_on) return;
+
+    // IR RX and the LF reader share timers, so only one of them runs at a time.
+    if(on) {
+        infrared_controller_pause(app->ir_controller);
+        lfrfid_reader_unpark(app->reader);
+    } else {
+        lfrfid_reader_park(app->reader);
+        infrared_controller_resume(app->ir_controller);
+    }
+    app->scan_antenna_on = on;
+}
+
+static void laser_tag_app_scan_finish(LaserTagApp* app, bool success, bool cancelled) {
+    if(!app->scanning) return;
+
+    timer_wheel_cancel(app->timers, LaserTagTimerScan);
+    laser_tag_app_scan_set_antenna(app, false);
+    app->scanning = false;
+    laser_tag_view_set_scanning(app->view, false);
+    frame_scheduler_request(app->frame_scheduler);
+
+    if(success) {
+        notification_message(app->notifications, &sequence_success);
+    } else if(!cancelled) {
+        notification_message(app->notifications, &sequence_error);
+    }
+    LASER_TAG_LOG_I(TAG, "Scan %s", success ? "succeeded" : cancelled ? "cancelled" : "timed out");
+}
+
+static void laser_tag_app_scan_start(LaserTagApp* app) {
+    if(!app->ir_controller || !app->reader) return;
+
+    notification_message(app->notifications, &sequence_short_beep);
+    app->scanning = true;
+    app->scan_deadline = furi_get_tick() + furi_ms_to_ticks(LASER_TAG_SCAN_TIMEOUT_MS);
+    laser_tag_view_set_scanning(app->view, true);
+    frame_scheduler_request(app->frame_scheduler);
+
+    laser_tag_app_scan_set_antenna(app, true);
+    laser_tag_app_schedule(
+        app, LaserTagTimerScan, furi_ms_to_ticks(LASER_TAG_SCAN_RFID_WINDOW_MS));
+}
+
+static void laser_tag_app_handle_scan_timer(LaserTagApp* app) {
+    if(!app->scanning) return;
+
+    int32_t remaining = (int32_t)(app->scan_deadline - furi_get_tick());
+    if(remaining <= 0) {
+        laser_tag_app_scan_finish(app, false, false);
+        return;
+    }
+
+    // Flip to the other window, never running past the scan deadline.
+    bool antenna_on = !app->scan_antenna_on;
+    uint32_t window = furi_ms_to_ticks(
+        antenna_on ? LASER_TAG_SCAN_RFID_WINDOW_MS : LASER_TAG_SCAN_IR_WINDOW_MS);
+    laser_tag_app_scan_set_antenna(app, antenna_on);
+    laser_tag_app_schedule(app, LaserTagTimerScan, MIN(window, (uint32_t)remaining));
+}
+
+static bool laser_tag_app_enter_referee(LaserTagApp* app) {
+    if(!laser_tag_app_ensure_controller(app)) return false;
+    LASER_TAG_LOG_I(TAG, "Refereeing");
+    // A referee only transmits, so the receiver stays off.
+    app->state = LaserTagStateReferee;
+    app->match_id = 0;
+    app->referee_live = false;
+    app->beacon_repeats = 0;
+    infrared_controller_set_tx_profile(app->ir_controller, app->tx_profile);
+    frame_scheduler_request(app->frame_scheduler);
+    return true;
+}
+
+static void laser_tag_app_referee_toggle(LaserTagApp* app) {
+    app->referee_live = !app->referee_live;
+    if(app->referee_live) {
+        // Never 0, which stands for a round started on the unit itself.
+        app->match_id = furi_hal_random_get() % LASER_TAG_PACKET_BEACON_VALUE_MASK + 1;
+        // Players start their clocks when the first start frame ends, so ours does too.
+        app->match_epoch = furi_get_tick() + furi_ms_to_ticks(LASER_TAG_PACKET_FRAME_MS);
+        app->syncs_sent = 0;
+        LASER_TAG_LOG_I(TAG, "Starting match %03X", app->match_id);
+    } else {
+        LASER_TAG_LOG_I(TAG, "Stopping match %03X", app->match_id);
+    }
+    app->beacon_repeats = LASER_TAG_BEACON_REPEATS;
+    laser_tag_app_schedule(app, LaserTagTimerBeacon, 0);
+    frame_scheduler_request(app->frame_scheduler);
+}
+
+static void laser_tag_app_handle_beacon_timer(LaserTagApp* app) {
+    if(app->state != LaserTagStateReferee || !app->ir_controller) return;
+
+    if(app->beacon_repeats > 0) {
+        app->beacon_repeats--;
+        infrared_controller_send_beacon(
+            app->ir_controller,
+            app->referee_live ? LaserTagPacketBeaconStart : LaserTagPacketBeaconStop,
+            app->match_id);
+        laser_tag_app_schedule(
+            app, LaserTagTimerBeacon, furi_ms_to_ticks(LASER_TAG_BEACON_REPEAT_MS));
+    } else if(app->referee_live) {
+        infrared_controller_send_sync(app->ir_controller, app->match_epoch);
+        app->syncs_sent++;
+        laser_tag_app_schedule(
+            app, LaserTagTimerBeacon, furi_ms_to_ticks(LASER_TAG_BEACON_SYNC_MS));
+    }
+    frame_scheduler_request(app->frame_scheduler);
+}
+
+static void laser_tag_app_handle_timers(LaserTagApp* app) {
+    app->timers_due = 0;
+    timer_wheel_advance(app->timers, furi_get_tick());
+
+    if(app->timers_due & (1UL << LaserTagTimerClock)) laser_tag_app_handle_clock(app);
+    if(app->timers_due & (1UL << LaserTagTimerFire)) laser_tag_app_run_weapon(app);
+    if(app->timers_due & (1UL << LaserTagTimerScan)) laser_tag_app_handle_scan_timer(app);
+    if(app->timers_due & (1UL << LaserTagTimerBeacon)) laser_tag_app_handle_beacon_timer(app);
+    if((app->timers_due & (1UL << LaserTagTimerIdle)) && app->idle) {
+        LASER_TAG_LOG_I(TAG, "Dimming the backlight");
+        notification_message(app->notifications, &sequence_display_backlight_dim);
+        app->dimmed = true;
+    }
+}
+
+static void laser_tag_app_handle_tag_read(
+    LaserTagApp* app,
+    uint8_t protocol,
+    const uint8_t* data,
+    uint8_t length) {
+    if(!app->scanning) {
+        // Late read from a window that has just been closed.
+        LASER_TAG_LOG_D(TAG, "Ignoring tag read outside of a scan");
+        return;
+    }
+
+    if(laser_tag_app_handle_tag(app, protocol, data, length)) {
+        laser_tag_app_scan_finish(app, true, false);
+    }
+}
+
+static bool laser_tag_app_handle_input(LaserTagApp* app, const InputEvent* event) {
+    LASER_TAG_LOG_D(TAG, "Received input event: type=%d, key=%d", event->type, event->key);
+
+    // Hidden latency screen: hold Down on the splash screen.
+    if(app->state == LaserTagStateSplashScreen && event->type == InputTypeLong &&
+       event->key == InputKeyDown) {
+        LASER_TAG_LOG_I(TAG, "Opening latency debug screen");
+        app->state = LaserTagStateDebug;
+        frame_scheduler_request(app->frame_scheduler);
+        return true;
+    }
+
+    // Up on the splash screen joins a refereed match; hold it to referee one instead.
+    if(app->state == LaserTagStateSplashScreen && event->key == InputKeyUp) {
+        if(event->type == InputTypeShort) return laser_tag_app_enter_waiting(app);
+        if(event->type == InputTypeLong) return laser_tag_app_enter_referee(app);
+        return true;
+    }
+
+    // Down on the splash screen picks the next player id; every unit in a match needs its own.
+    if(app->state == LaserTagStateSplashScreen && event->key == InputKeyDown) {
+        if(event->type == InputTypeShort) {
+            app->player_id = (app->player_id + 1) % LASER_TAG_PACKET_MAX_PLAYERS;
+            app->player_id_changed = true;
+            LASER_TAG_LOG_I(TAG, "Playing as P%02d", app->player_id);
+            frame_scheduler_request(app->frame_scheduler);
+        }
+        return true;
+    }
+
+    // The shot scheduler does its own repeat while the trigger is held.
+    if(app->state == LaserTagStateGame && event->key == InputKeyOk) {
+        if(event->type == InputTypePress || event->type == InputTypeRelease) {
+            shot_scheduler_set_trigger(app->shot_scheduler, event->type == InputTypePress);
+            laser_tag_app_run_weapon(app);
+        }
+        return true;
+    }
+
+    if(event->type != InputTypePress && event->type != InputTypeRepeat) {
+        return true;
+    }
+
+    if(app->state == LaserTagStateSplashScreen) {
+        switch(event->key) {
+        case InputKeyOk:
+            LASER_TAG_LOG_I(TAG, "Ok pressed, starting");
+            return laser_tag_app_enter_game_state(app, 0);
+        case InputKeyBack:
+            LASER_TAG_LOG_I(TAG, "Back key pressed, exiting");
+            return false;
+        case InputKeyLeft:
+        case InputKeyRight:
+            app->tx_profile = (app->tx_profile + (event->key == InputKeyRight ? 1 : -1) +
+                               InfraredControllerTxProfileCount) %
+                              InfraredControllerTxProfileCount;
+            LASER_TAG_LOG_I(
+                TAG,
+                "TX profile %s selected",
+                infrared_controller_get_tx_profile_name(app->tx_profile));
+            frame_scheduler_request(app->frame_scheduler);
+            break;
+        default:
+            break;
+        }
+    } else if(app->state == LaserTagStateDebug) {
+        if(event->key == InputKeyOk) {
+            LASER_TAG_LOG_I(TAG, "Resetting latency histograms");
+            laser_tag_profiler_reset();
+        } else if(event->key == InputKeyBack) {
+            app->state = LaserTagStateSplashScreen;
+        }
+        frame_scheduler_request(app->frame_scheduler);
+    } else if(app->state == LaserTagStateWaiting) {
+        if(event->key == InputKeyBack) {
+            LASER_TAG_LOG_I(TAG, "Back key pressed, no longer waiting for a referee");
+            app->state = LaserTagStateSplashScreen;
+            frame_scheduler_request(app->frame_scheduler);
+        }
+    } else if(app->state == LaserTagStateReferee) {
+        if(event->type != InputTypePress) return true;
+        if(event->key == InputKeyOk && app->beacon_repeats == 0) {
+            laser_tag_app_referee_toggle(app);
+        } else if(event->key == InputKeyBack) {
+            // A running match is stopped first; leaving takes a second press.
+            if(app->referee_live) {
+                laser_tag_app_referee_toggle(app);
+            } else if(app->beacon_repeats == 0) {
+                app->state = LaserTagStateSplashScreen;
+                frame_scheduler_request(app->frame_scheduler);
+            }
+        }
+    } else if(app->state == LaserTagStateGameOver) {
+        if(event->key == InputKeyOk) {
+            LASER_TAG_LOG_I(TAG, "OK key pressed, restarting game");
+
+            // Restart game by resetting game state and transitioning to splash screen
+            game_state_reset(app->game_state);
+            app->state = LaserTagStateSplashScreen;
+            frame_scheduler_request(app->frame_scheduler);
+        }
+    } else if(app->state == LaserTagStateGame) {
+        if(event->key == InputKeyDown && game_state_get_ammo(app->game_state) == 0) {
+            // Reload when Down is pressed with the magazine empty; it takes the weapon's time.
+            if(shot_scheduler_reload(app->shot_scheduler, furi_get_tick())) {
+                LASER_TAG_LOG_I(TAG, "Down key pressed, reloading ammo");
+                frame_scheduler_request(app->frame_scheduler);
+                laser_tag_app_run_weapon(app);
+            }
+        } else {
+            switch(event->key) {
+            case InputKeyBack:
+                LASER_TAG_LOG_I(TAG, "Back key pressed, exiting");
+                return false;
+            case InputKeyLeft:
+            case InputKeyRight:
+                if(event->type != InputTypePress) break;
+                laser_tag_app_select_weapon(
+                    app,
+                    (shot_scheduler_get_weapon(app->shot_scheduler) +
+                     (event->key == InputKeyRight ? 1 : -1) + WeaponIdCount) %
+                        WeaponIdCount);
+                break;
+            case InputKeyUp:
+                if(event->type != InputTypePress) break;
+                if(app->scanning) {
+                    LASER_TAG_LOG_I(TAG, "Up key pressed, cancelling scan");
+                    laser_tag_app_scan_finish(app, false, true);
+                } else {
+                    LASER_TAG_LOG_I(TAG, "Up key pressed, scanning for a pickup");
+                    laser_tag_app_scan_start(app);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
     return true;
 }
 
 int32_t laser_tag_app(void* p) {
     UNUSED(p);
-    FURI_LOG_I(TAG, "Laser Tag app starting");
+    LASER_TAG_LOG_I(TAG, "Laser Tag app starting");
 
     LaserTagApp* app = laser_tag_app_alloc();
     if(!app) {
         FURI_LOG_E(TAG, "Failed to allocate application");
         return -1;
     }
-    FURI_LOG_D(TAG, "LaserTagApp allocated successfully");
+    LASER_TAG_LOG_D(TAG, "LaserTagApp allocated successfully");
 
-    InputEvent event;
+    LaserTagEvent event;
     bool running = true;
     while(running) {
-        FURI_LOG_D(TAG, "Start of main loop iteration");
-
-        update_infrared_board_status(app->ir_controller);
-
-        FuriStatus status = furi_message_queue_get(app->event_queue, &event, 100);
-        if(status == FuriStatusOk) {
-            FURI_LOG_D(TAG, "Received input event: type=%d, key=%d", event.type, event.key);
-            if(event.type == InputTypePress || event.type == InputTypeRepeat) {
-                if(app->state == LaserTagStateSplashScreen) {
-                    switch(event.key) {
-                    case InputKeyOk:
-                        FURI_LOG_I(TAG, "Ok pressed, starting");
-                        if(!laser_tag_app_enter_game_state(app)) {
-                            running = false;
-                        }
-                        break;
-                    case InputKeyBack:
-                        FURI_LOG_I(TAG, "Back key pressed, exiting");
-                        running = false;
-                        break;
-                    default:
-                        break;
-                    }
-                } else if(app->state == LaserTagStateGameOver) {
-                    if(event.key == InputKeyOk) {
-                        FURI_LOG_I(TAG, "OK key pressed, restarting game");
-
-                        // Restart game by resetting game state and transitioning to splash screen
-                        game_state_reset(app->game_state);
-                        app->state = LaserTagStateSplashScreen;
-                        app->need_redraw = true;
-                    }
-                } else if(app->state == LaserTagStateGame) {
-                    if(event.key == InputKeyDown && game_state_get_ammo(app->game_state) == 0) {
-                        // Reload ammo when Down button is pressed and ammo is depleted
-                        FURI_LOG_I(TAG, "Down key pressed, reloading ammo");
-                        game_state_increase_ammo(app->game_state, INITIAL_AMMO);
-                        app->need_redraw = true;
-                    } else {
-                        switch(event.key) {
-                        case InputKeyBack:
-                            FURI_LOG_I(TAG, "Back key pressed, exiting");
-                            running = false;
-                            break;
-                        case InputKeyOk:
-                            FURI_LOG_I(TAG, "OK key pressed, firing laser");
-                            laser_tag_app_fire(app);
-                            break;
-                        case InputKeyUp:
-                            FURI_LOG_I(TAG, "Up key pressed, scanning for ammo");
-                            notification_message(app->notifications, &sequence_short_beep);
-                            uint16_t ammo = game_state_get_ammo(app->game_state);
-                            infrared_controller_pause(app->ir_controller);
-                            lfrfid_reader_start(app->reader);
-                            for(int i = 0; i < 30; i++) {
-                                furi_delay_ms(100);
-                                if(ammo != game_state_get_ammo(app->game_state)) {
-                                    break;
-                                }
-                            }
-                            lfrfid_reader_stop(app->reader);
-                            infrared_controller_resume(app->ir_controller);
-                            if(ammo != game_state_get_ammo(app->game_state)) {
-                                notification_message(app->notifications, &sequence_success);
-                            } else {
-                                notification_message(app->notifications, &sequence_error);
-                            }
-                            app->need_redraw = true;
-                            break;
-                        default:
-                            break;
-                        }
-                    }
-                }
-            }
-        } else if(status == FuriStatusErrorTimeout) {
-            FURI_LOG_D(TAG, "No input event, continuing");
-        } else {
-            FURI_LOG_E(TAG, "Failed to get input event, status: %d", status);
+        // Block until there is real work; every producer posts to this queue.
+        FuriStatus status = furi_message_queue_get(app->event_queue, &event, FuriWaitForever);
+        if(status != FuriStatusOk) {
+            FURI_LOG_E(TAG, "Failed to get event, status: %d", status);
+            continue;
         }
 
-        if(app->state == LaserTagStateGame && app->ir_controller) {
-            if(infrared_controller_receive(app->ir_controller)) {
-                FURI_LOG_D(TAG, "Hit received, processing");
-                laser_tag_app_handle_hit(app);
-            }
+        // Bring game time up to date first, so every handler sees the current clock.
+        laser_tag_app_advance_clock(app);
 
-            if(game_state_is_game_over(app->game_state)) {
-                FURI_LOG_I(TAG, "Game over, notifying user with error sequence");
-                notification_message(app->notifications, &sequence_error);
-                // Stop game logic after game over
-                app->state = LaserTagStateGameOver;
-                app->need_redraw = true;
-            }
-        } else if(app->state == LaserTagStateGameOver) {
-            if(event.key == InputKeyOk) {
-                FURI_LOG_I(TAG, "OK key pressed, restarting game");
-                game_state_reset(app->game_state);
-                app->state = LaserTagStateSplashScreen;
-                app->need_redraw = true;
-            }
+        switch(event.type) {
+        case LaserTagEventTypeInput:
+            laser_tag_app_touch_idle(app);
+            app->input_cycles = event.cycles;
+            running = laser_tag_app_handle_input(app, &event.input);
+            app->input_cycles = 0;
+            break;
+        case LaserTagEventTypeHit:
+            laser_tag_app_drain_hits(app);
+            break;
+        case LaserTagEventTypeTagRead:
+            laser_tag_app_handle_tag_read(
+                app, event.tag.protocol, event.tag.data, event.tag.length);
+            break;
+        case LaserTagEventTypeTick:
+            laser_tag_app_handle_timers(app);
+            break;
+        case LaserTagEventTypeFrame:
+            // A deferred frame is due; committing below takes it.
+            break;
         }
 
-        if(app->need_redraw) {
-            FURI_LOG_D(TAG, "Updating viewport");
-            view_port_update(app->view_port);
-            app->need_redraw = false;
+        // A scan never outlives the round it was started in.
+        if(app->scanning && (!running || app->state != LaserTagStateGame)) {
+            laser_tag_app_scan_finish(app, false, true);
+        }
+        if(running) {
+            laser_tag_app_update_idle(app);
+            laser_tag_app_arm_timer(app);
         }
 
-        FURI_LOG_D(TAG, "End of main loop iteration");
-        furi_delay_ms(10);
+        laser_tag_app_commit_frame(app);
     }
 
-    FURI_LOG_I(TAG, "Laser Tag app exiting");
+    LASER_TAG_LOG_I(TAG, "Laser Tag app exiting");
     laser_tag_app_free(app);
+    laser_tag_trace_dump();
     return 0;
 }
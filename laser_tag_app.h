@@ -11,6 +11,7 @@
 #include <gui/scene_manager.h>
 #include <gui/modules/variable_item_list.h>
 #include <gui/modules/button_menu.h>
+#include "hit_queue.h"
 
 #define FRAME_WIDTH  128
 #define FRAME_HEIGHT 64
@@ -22,5 +23,5 @@ void laser_tag_app_free(LaserTagApp* app);
 int32_t laser_tag_app(void* p);
 void laser_tag_app_set_view_port(LaserTagApp* app, View* view);
 void laser_tag_app_switch_to_next_scene(LaserTagApp* app);
-void laser_tag_app_fire(LaserTagApp* app);
-void laser_tag_app_handle_hit(LaserTagApp* app);
+bool laser_tag_app_fire(LaserTagApp* app);
+void laser_tag_app_handle_hits(LaserTagApp* app, const HitRecord* hits, size_t count);
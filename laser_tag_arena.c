@@ -0,0 +1,37 @@
+#include "laser_tag_arena.h"
+#include <furi.h>
+#include <string.h>
+
+#define TAG "LaserTagArena"
+
+#define LASER_TAG_ARENA_ALIGN 8
+
+static uint8_t laser_tag_arena[LASER_TAG_ARENA_SIZE]
+    __attribute__((aligned(LASER_TAG_ARENA_ALIGN)));
+static size_t laser_tag_arena_used;
+
+void* laser_tag_arena_alloc(size_t size) {
+    size_t aligned = (size + LASER_TAG_ARENA_ALIGN - 1) & ~(size_t)(LASER_TAG_ARENA_ALIGN - 1);
+    if(aligned > LASER_TAG_ARENA_SIZE - laser_tag_arena_used) {
+        FURI_LOG_E(
+            TAG,
+            "Arena exhausted: %zu bytes requested, %zu of %d used",
+            size,
+            laser_tag_arena_used,
+            LASER_TAG_ARENA_SIZE);
+        return NULL;
+    }
+
+    void* block = &laser_tag_arena[laser_tag_arena_used];
+    laser_tag_arena_used += aligned;
+    memset(block, 0, aligned);
+    return block;
+}
+
+size_t laser_tag_arena_get_used() {
+    return laser_tag_arena_used;
+}
+
+void laser_tag_arena_reset() {
+    laser_tag_arena_used = 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+/**
+* @file laser_tag_arena.h
+* @brief One static block that holds every long-lived object of the app.
+* @details Subsystems take their state from the arena at startup instead of each calling malloc,
+* so the app's footprint is fixed at build time and it does not fragment the shared heap. The
+* arena only grows; nothing is handed back until the app exits. Objects that live for a whole
+* session are therefore reset in place, never freed and reallocated. Firmware objects (threads,
+* timers, views, workers) still come from the firmware heap.
+*
+* The size is set by LASER_TAG_ARENA_SIZE in application.fam.
+*/
+
+#include <stddef.h>
+
+#ifndef LASER_TAG_ARENA_SIZE
+#define LASER_TAG_ARENA_SIZE 5632
+#endif
+
+/**
+ * @brief Carves a zeroed, 8-byte aligned block out of the arena.
+ * @warning Not thread safe; only allocate from the app thread.
+ * @param size Block size in bytes.
+ * @return Pointer to the block, or NULL if the arena is exhausted.
+ */
+void* laser_tag_arena_alloc(size_t size);
+
+/**
+ * @brief Returns the number of bytes handed out so far, alignment padding included.
+ * @return Bytes used.
+ */
+size_t laser_tag_arena_get_used();
+
+/**
+ * @brief Releases everything at once.
+ * @warning Only call once every object allocated from the arena is gone.
+ */
+void laser_tag_arena_reset();
@@ -0,0 +1,63 @@
+#include "laser_tag_log.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef LASER_TAG_LOG_TRACE
+
+typedef struct {
+    uint32_t tick;
+    const char* tag;
+    char line[LASER_TAG_TRACE_LINE_SIZE];
+} LaserTagTraceRecord;
+
+static LaserTagTraceRecord laser_tag_trace_ring[LASER_TAG_TRACE_SIZE];
+static uint32_t laser_tag_trace_head;
+
+void laser_tag_trace_record(const char* tag, const char* format, ...) {
+    // Format before taking the ring so the critical section stays a copy.
+    char line[LASER_TAG_TRACE_LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    uint32_t tick = furi_get_tick();
+
+    // Traces come from several threads; a short critical section keeps records whole.
+    FURI_CRITICAL_ENTER();
+    LaserTagTraceRecord* record =
+        &laser_tag_trace_ring[laser_tag_trace_head++ % LASER_TAG_TRACE_SIZE];
+    record->tick = tick;
+    record->tag = tag;
+    memcpy(record->line, line, sizeof(record->line));
+    FURI_CRITICAL_EXIT();
+}
+
+void laser_tag_trace_dump(void) {
+    uint32_t head = laser_tag_trace_head;
+    uint32_t start = head > LASER_TAG_TRACE_SIZE ? head - LASER_TAG_TRACE_SIZE : 0;
+
+    FURI_LOG_I("LaserTagTrace", "Dumping %lu trace records", (unsigned long)(head - start));
+    for(uint32_t i = start; i < head; i++) {
+        const LaserTagTraceRecord* record = &laser_tag_trace_ring[i % LASER_TAG_TRACE_SIZE];
+        FURI_LOG_I(
+            "LaserTagTrace",
+            "%lu %s: %s",
+            (unsigned long)record->tick,
+            record->tag,
+            record->line);
+    }
+    laser_tag_trace_head = 0;
+}
+
+#else
+
+void laser_tag_trace_record(const char* tag, const char* format, ...) {
+    UNUSED(tag);
+    UNUSED(format);
+}
+
+void laser_tag_trace_dump(void) {
+}
+
+#endif
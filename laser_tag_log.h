@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+* @file laser_tag_log.h
+* @brief Build-time log tiers for the game's hot paths.
+* @details LASER_TAG_LOG_LEVEL is set through cdefines in application.fam. Debug and info calls
+* above that level compile to dead code, so neither their formatting nor their strings make it
+* into the binary. Warnings and errors keep using FURI_LOG_W/FURI_LOG_E directly.
+*
+* Defining LASER_TAG_LOG_TRACE routes the enabled debug/info calls into a RAM ring instead of
+* the log UART. Each call is formatted into its slot right away, so string arguments may be
+* locals and any conversion printf takes is fine; long lines are cut short. Nothing is printed
+* until laser_tag_trace_dump() is called.
+*/
+
+#include <furi.h>
+
+#define LASER_TAG_LOG_LEVEL_NONE  0
+#define LASER_TAG_LOG_LEVEL_ERROR 1
+#define LASER_TAG_LOG_LEVEL_WARN  2
+#define LASER_TAG_LOG_LEVEL_INFO  3
+#define LASER_TAG_LOG_LEVEL_DEBUG 4
+
+#ifndef LASER_TAG_LOG_LEVEL
+#define LASER_TAG_LOG_LEVEL LASER_TAG_LOG_LEVEL_WARN
+#endif
+
+/** Number of records kept by the trace ring. */
+#define LASER_TAG_TRACE_SIZE 32
+
+/** Size of a record's formatted text, including the terminator. */
+#define LASER_TAG_TRACE_LINE_SIZE 48
+
+/**
+ * @brief Formats a record into the trace ring. Use the LASER_TAG_LOG_* macros instead.
+ * @param tag Log tag, must outlive the ring.
+ * @param format printf-style format string.
+ */
+void laser_tag_trace_record(const char* tag, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Prints and clears the trace ring. No-op unless LASER_TAG_LOG_TRACE is defined.
+ */
+void laser_tag_trace_dump(void);
+
+#ifdef LASER_TAG_LOG_TRACE
+#define LASER_TAG_LOG_EMIT(level, tag, format, ...) \
+    laser_tag_trace_record(tag, format, ##__VA_ARGS__)
+#else
+#define LASER_TAG_LOG_EMIT(level, tag, format, ...) FURI_LOG_##level(tag, format, ##__VA_ARGS__)
+#endif
+
+// Compiled-out calls stay type-checked but are removed as dead code.
+#define LASER_TAG_LOG_DISCARD(level, tag, format, ...)       \
+    do {                                                     \
+        if(0) FURI_LOG_##level(tag, format, ##__VA_ARGS__); \
+    } while(0)
+
+#if LASER_TAG_LOG_LEVEL >= LASER_TAG_LOG_LEVEL_INFO
+#define LASER_TAG_LOG_I(tag, format, ...) LASER_TAG_LOG_EMIT(I, tag, format, ##__VA_ARGS__)
+#else
+#define LASER_TAG_LOG_I(tag, format, ...) LASER_TAG_LOG_DISCARD(I, tag, format, ##__VA_ARGS__)
+#endif
+
+#if LASER_TAG_LOG_LEVEL >= LASER_TAG_LOG_LEVEL_DEBUG
+#define LASER_TAG_LOG_D(tag, format, ...) LASER_TAG_LOG_EMIT(D, tag, format, ##__VA_ARGS__)
+#else
+#define LASER_TAG_LOG_D(tag, format, ...) LASER_TAG_LOG_DISCARD(D, tag, format, ##__VA_ARGS__)
+#endif
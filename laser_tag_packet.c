@@ -0,0 +1,104 @@
+#include "laser_tag_packet.h"
+
+#define LASER_TAG_PACKET_KIND_SHIFT   6
+#define LASER_TAG_PACKET_WEAPON_SHIFT 3
+#define LASER_TAG_PACKET_PLAYER_SHIFT 3
+#define LASER_TAG_PACKET_VICTIM_SHIFT 1
+#define LASER_TAG_PACKET_BEACON_SHIFT 4
+#define LASER_TAG_PACKET_VALUE_SHIFT  8
+
+#define LASER_TAG_PACKET_KIND_MASK   0x03
+#define LASER_TAG_PACKET_WEAPON_MASK 0x07
+#define LASER_TAG_PACKET_DAMAGE_MASK 0x07
+#define LASER_TAG_PACKET_PLAYER_MASK 0x1F
+#define LASER_TAG_PACKET_TEAM_MASK   0x07
+#define LASER_TAG_PACKET_KILL_MASK   0x01
+#define LASER_TAG_PACKET_BEACON_MASK 0x03
+#define LASER_TAG_PACKET_VALUE_MASK  0x0F
+
+static const LaserTagPacketKind laser_tag_packet_kinds[LASER_TAG_PACKET_KIND_MASK + 1] = {
+    [0x0] = LaserTagPacketKindInvalid,
+    [0x1] = LaserTagPacketKindBeacon,
+    [0x2] = LaserTagPacketKindShoot,
+    [0x3] = LaserTagPacketKindAck,
+};
+
+static const uint8_t laser_tag_packet_kind_codes[] = {
+    [LaserTagPacketKindInvalid] = 0x0,
+    [LaserTagPacketKindBeacon] = 0x1,
+    [LaserTagPacketKindShoot] = 0x2,
+    [LaserTagPacketKindAck] = 0x3,
+};
+
+static const uint8_t laser_tag_packet_damage[LASER_TAG_PACKET_DAMAGE_CLASSES] = {
+    5,
+    10,
+    15,
+    20,
+    25,
+    35,
+    50,
+    100,
+};
+
+bool laser_tag_packet_decode(uint32_t address, uint32_t command, LaserTagPacket* packet) {
+    packet->kind =
+        laser_tag_packet_kinds[(command >> LASER_TAG_PACKET_KIND_SHIFT) & LASER_TAG_PACKET_KIND_MASK];
+    packet->weapon = (command >> LASER_TAG_PACKET_WEAPON_SHIFT) & LASER_TAG_PACKET_WEAPON_MASK;
+    packet->damage_class = command & LASER_TAG_PACKET_DAMAGE_MASK;
+    packet->player_id = (address >> LASER_TAG_PACKET_PLAYER_SHIFT) & LASER_TAG_PACKET_PLAYER_MASK;
+    packet->team_id = address & LASER_TAG_PACKET_TEAM_MASK;
+    packet->victim_id = (command >> LASER_TAG_PACKET_VICTIM_SHIFT) & LASER_TAG_PACKET_PLAYER_MASK;
+    packet->kill = command & LASER_TAG_PACKET_KILL_MASK;
+    packet->beacon = (command >> LASER_TAG_PACKET_BEACON_SHIFT) & LASER_TAG_PACKET_BEACON_MASK;
+    packet->beacon_value =
+        (((command & LASER_TAG_PACKET_VALUE_MASK) << LASER_TAG_PACKET_VALUE_SHIFT) | address) &
+        LASER_TAG_PACKET_BEACON_VALUE_MASK;
+
+    // Anything wider than 8 bits came from another protocol.
+    return (packet->kind != LaserTagPacketKindInvalid) & (((address | command) >> 8) == 0) &
+           ((packet->kind != LaserTagPacketKindBeacon) |
+            (packet->beacon < LaserTagPacketBeaconCount));
+}
+
+void laser_tag_packet_encode(const LaserTagPacket* packet, uint32_t* address, uint32_t* command) {
+    if(packet->kind == LaserTagPacketKindBeacon) {
+        *address = packet->beacon_value & 0xFF;
+        *command =
+            ((uint32_t)laser_tag_packet_kind_codes[packet->kind] << LASER_TAG_PACKET_KIND_SHIFT) |
+            ((uint32_t)(packet->beacon & LASER_TAG_PACKET_BEACON_MASK)
+             << LASER_TAG_PACKET_BEACON_SHIFT) |
+            ((packet->beacon_value >> LASER_TAG_PACKET_VALUE_SHIFT) & LASER_TAG_PACKET_VALUE_MASK);
+        return;
+    }
+
+    *address = ((uint32_t)(packet->player_id & LASER_TAG_PACKET_PLAYER_MASK)
+                << LASER_TAG_PACKET_PLAYER_SHIFT) |
+               (packet->team_id & LASER_TAG_PACKET_TEAM_MASK);
+    *command = (uint32_t)laser_tag_packet_kind_codes[packet->kind] << LASER_TAG_PACKET_KIND_SHIFT;
+    if(packet->kind == LaserTagPacketKindAck) {
+        *command |= ((uint32_t)(packet->victim_id & LASER_TAG_PACKET_PLAYER_MASK)
+                     << LASER_TAG_PACKET_VICTIM_SHIFT) |
+                    (packet->kill ? LASER_TAG_PACKET_KILL_MASK : 0);
+    } else {
+        *command |= ((uint32_t)(packet->weapon & LASER_TAG_PACKET_WEAPON_MASK)
+                     << LASER_TAG_PACKET_WEAPON_SHIFT) |
+                    (packet->damage_class & LASER_TAG_PACKET_DAMAGE_MASK);
+    }
+}
+
+uint8_t laser_tag_packet_get_damage(const LaserTagPacket* packet) {
+    return laser_tag_packet_damage[packet->damage_class & LASER_TAG_PACKET_DAMAGE_MASK];
+}
+
+bool laser_tag_packet_is_hostile(const LaserTagPacket* packet, uint8_t player_id, uint8_t team_id) {
+    return (packet->player_id != player_id) &
+           ((team_id == LASER_TAG_PACKET_TEAM_NONE) | (packet->team_id != team_id));
+}
+
+int32_t laser_tag_packet_get_sync_offset(const LaserTagPacket* packet, uint32_t local_ms) {
+    // Only the low bits of the referee's clock come across; take the nearest time that has them.
+    uint32_t span = LASER_TAG_PACKET_BEACON_VALUE_MASK + 1;
+    uint32_t ahead = (packet->beacon_value - local_ms) & LASER_TAG_PACKET_BEACON_VALUE_MASK;
+    return ahead < span / 2 ? (int32_t)ahead : (int32_t)ahead - (int32_t)span;
+}
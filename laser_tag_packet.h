@@ -0,0 +1,117 @@
+#pragma once
+
+/**
+* @file laser_tag_packet.h
+* @brief Laser tag packet carried in the NEC address/command space.
+* @details NEC carries an 8-bit address and an 8-bit command, each followed by its inverse, so
+* the receiver only ever sees frames that passed the protocol's own integrity check.
+*
+*   address: [7:3] player id (0-31), [2:0] team id (0 = free-for-all)
+*   command: [7:6] packet kind, [5:3] weapon, [2:0] damage class
+*
+* An ACK goes back from a victim to the shooter whose shot landed. Its player id is the shooter
+* it is addressed to, and the team bits are unused:
+*
+*   command: [7:6] packet kind, [5:1] victim id, [0] kill flag
+*
+* A beacon comes from a referee unit and is for everybody. Its payload takes every bit left:
+*
+*   address: [7:0] value[7:0]
+*   command: [7:6] packet kind, [5:4] beacon type, [3:0] value[11:8]
+*
+* Start and stop carry the match id. A sync carries the referee's match clock in milliseconds,
+* modulo 4096, as it was when the frame ended; receivers that are already within two seconds
+* find the rest from their own clock.
+*
+* Decoding is a handful of shifts and masks plus table lookups, so it is cheap enough for the
+* IR RX callback. The legacy 0x42/0xA1 shot decodes as a shot from player 8, team 2, with
+* 10 damage.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LASER_TAG_PACKET_MAX_PLAYERS 32
+#define LASER_TAG_PACKET_MAX_TEAMS   8
+#define LASER_TAG_PACKET_MAX_WEAPONS 8
+#define LASER_TAG_PACKET_DAMAGE_CLASSES 8
+
+/** Team id meaning "no team": everybody else is an opponent. */
+#define LASER_TAG_PACKET_TEAM_NONE 0
+
+/** Beacon payload width. */
+#define LASER_TAG_PACKET_BEACON_VALUE_BITS 12
+#define LASER_TAG_PACKET_BEACON_VALUE_MASK ((1U << LASER_TAG_PACKET_BEACON_VALUE_BITS) - 1)
+
+/**
+ * Air time of one of our frames. NEC sends address and command next to their inverses, so every
+ * frame has 16 ones and 16 zeros and lasts 67.5 ms whatever it carries.
+ */
+#define LASER_TAG_PACKET_FRAME_MS 68
+
+typedef enum {
+    LaserTagPacketKindInvalid,
+    LaserTagPacketKindShoot,
+    LaserTagPacketKindAck,
+    LaserTagPacketKindBeacon,
+} LaserTagPacketKind;
+
+typedef enum {
+    LaserTagPacketBeaconStart, /**< The match starts now. value: match id. */
+    LaserTagPacketBeaconStop, /**< The match is over. value: match id. */
+    LaserTagPacketBeaconSync, /**< value: referee's match clock in ms, modulo 4096. */
+    LaserTagPacketBeaconCount,
+} LaserTagPacketBeacon;
+
+typedef struct {
+    LaserTagPacketKind kind;
+    uint8_t player_id;
+    uint8_t team_id;
+    uint8_t weapon;
+    uint8_t damage_class;
+    uint8_t victim_id; /**< Ack only: player that was hit. */
+    bool kill; /**< Ack only: the hit ended the victim's game. */
+    uint8_t beacon; /**< Beacon only: LaserTagPacketBeacon. */
+    uint16_t beacon_value; /**< Beacon only: match id or clock, see LaserTagPacketBeacon. */
+} LaserTagPacket;
+
+/**
+ * @brief Decodes an NEC address/command pair.
+ * @param address Decoded NEC address.
+ * @param command Decoded NEC command.
+ * @param packet Decoded packet, filled in even when the frame is rejected.
+ * @return true if the frame is a laser tag packet.
+ */
+bool laser_tag_packet_decode(uint32_t address, uint32_t command, LaserTagPacket* packet);
+
+/**
+ * @brief Encodes a packet into an NEC address/command pair.
+ * @param packet Packet to encode, must not be LaserTagPacketKindInvalid.
+ * @param address Encoded NEC address.
+ * @param command Encoded NEC command.
+ */
+void laser_tag_packet_encode(const LaserTagPacket* packet, uint32_t* address, uint32_t* command);
+
+/**
+ * @brief Returns the hit points a shot packet takes away.
+ * @param packet Shot packet.
+ * @return Damage in hit points.
+ */
+uint8_t laser_tag_packet_get_damage(const LaserTagPacket* packet);
+
+/**
+ * @brief Tells whether a shot from packet's sender can hurt the given player.
+ * @param packet Shot packet.
+ * @param player_id Receiving player id.
+ * @param team_id Receiving team id.
+ * @return false for self-hits and friendly fire.
+ */
+bool laser_tag_packet_is_hostile(const LaserTagPacket* packet, uint8_t player_id, uint8_t team_id);
+
+/**
+ * @brief Works out how far our clock is from the referee's, from a sync beacon.
+ * @param packet Sync beacon.
+ * @param local_ms Our match clock when the beacon was received.
+ * @return Milliseconds to add to our clock, between -2048 and 2047.
+ */
+int32_t laser_tag_packet_get_sync_offset(const LaserTagPacket* packet, uint32_t local_ms);
@@ -0,0 +1,76 @@
+#include "laser_tag_profiler.h"
+#include <furi.h>
+#include <furi_hal_cortex.h>
+#include <string.h>
+
+static const uint32_t laser_tag_profiler_bucket_limits[LASER_TAG_PROFILER_BUCKETS] = {
+    100,
+    250,
+    500,
+    1000,
+    2500,
+    5000,
+    10000,
+    25000,
+    50000,
+    100000,
+    UINT32_MAX,
+};
+
+static const char* const laser_tag_profiler_names[LaserTagProfilerSpanCount] = {
+    [LaserTagProfilerSpanInputToFire] = "In>Fire",
+    [LaserTagProfilerSpanFireToTx] = "Fire>TX",
+    [LaserTagProfilerSpanTx] = "TX",
+    [LaserTagProfilerSpanRxToHit] = "RX>Hit",
+};
+
+static LaserTagProfilerHistogram laser_tag_profiler_histograms[LaserTagProfilerSpanCount];
+
+uint32_t laser_tag_profiler_now(void) {
+    // The timer start is a raw DWT->CYCCNT sample.
+    return furi_hal_cortex_timer_get(0).start;
+}
+
+void laser_tag_profiler_record(LaserTagProfilerSpan span, uint32_t start_cycles) {
+    furi_assert(span < LaserTagProfilerSpanCount);
+
+    uint32_t elapsed_us =
+        (laser_tag_profiler_now() - start_cycles) / furi_hal_cortex_instructions_per_microsecond();
+
+    uint8_t bucket = 0;
+    while(elapsed_us > laser_tag_profiler_bucket_limits[bucket]) {
+        bucket++;
+    }
+
+    LaserTagProfilerHistogram* histogram = &laser_tag_profiler_histograms[span];
+    if(histogram->buckets[bucket] < UINT16_MAX) {
+        histogram->buckets[bucket]++;
+    }
+    if(histogram->count == 0 || elapsed_us < histogram->min_us) {
+        histogram->min_us = elapsed_us;
+    }
+    if(elapsed_us > histogram->max_us) {
+        histogram->max_us = elapsed_us;
+    }
+    histogram->sum_us += elapsed_us;
+    histogram->count++;
+}
+
+const LaserTagProfilerHistogram* laser_tag_profiler_get(LaserTagProfilerSpan span) {
+    furi_assert(span < LaserTagProfilerSpanCount);
+    return &laser_tag_profiler_histograms[span];
+}
+
+uint32_t laser_tag_profiler_get_bucket_limit(uint8_t bucket) {
+    furi_assert(bucket < LASER_TAG_PROFILER_BUCKETS);
+    return laser_tag_profiler_bucket_limits[bucket];
+}
+
+const char* laser_tag_profiler_get_name(LaserTagProfilerSpan span) {
+    furi_assert(span < LaserTagProfilerSpanCount);
+    return laser_tag_profiler_names[span];
+}
+
+void laser_tag_profiler_reset(void) {
+    memset(laser_tag_profiler_histograms, 0, sizeof(laser_tag_profiler_histograms));
+}
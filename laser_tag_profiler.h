@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+* @file laser_tag_profiler.h
+* @brief Hot-path latency histograms.
+* @details Timestamps come from the Cortex-M4 DWT cycle counter, which the firmware keeps
+* running for its own microsecond delays. Each span keeps fixed buckets in RAM and is only ever
+* recorded from a single thread, so recording is a few arithmetic operations with no locking.
+*/
+
+#include <stdint.h>
+
+typedef enum {
+    LaserTagProfilerSpanInputToFire, /**< Input callback to laser_tag_app_fire. */
+    LaserTagProfilerSpanFireToTx, /**< laser_tag_app_fire to transmit start. */
+    LaserTagProfilerSpanTx, /**< Transmit start to transmit end. */
+    LaserTagProfilerSpanRxToHit, /**< RX decode to laser_tag_app_handle_hit. */
+    LaserTagProfilerSpanCount,
+} LaserTagProfilerSpan;
+
+#define LASER_TAG_PROFILER_BUCKETS 11
+
+typedef struct {
+    uint16_t buckets[LASER_TAG_PROFILER_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} LaserTagProfilerHistogram;
+
+/**
+ * @brief Returns the current cycle counter, to be passed to laser_tag_profiler_record().
+ * @return Raw cycle count.
+ */
+uint32_t laser_tag_profiler_now(void);
+
+/**
+ * @brief Records the time elapsed since start_cycles into the span's histogram.
+ * @param span Span to record.
+ * @param start_cycles Value returned by laser_tag_profiler_now() at the start of the span.
+ */
+void laser_tag_profiler_record(LaserTagProfilerSpan span, uint32_t start_cycles);
+
+/**
+ * @brief Returns the histogram of a span.
+ * @param span Span to query.
+ * @return Histogram, owned by the profiler.
+ */
+const LaserTagProfilerHistogram* laser_tag_profiler_get(LaserTagProfilerSpan span);
+
+/**
+ * @brief Returns the upper bound of a bucket in microseconds, UINT32_MAX for the last one.
+ * @param bucket Bucket index.
+ * @return Upper bound in microseconds.
+ */
+uint32_t laser_tag_profiler_get_bucket_limit(uint8_t bucket);
+
+/**
+ * @brief Returns a short display name for a span.
+ * @param span Span to query.
+ * @return Name of the span.
+ */
+const char* laser_tag_profiler_get_name(LaserTagProfilerSpan span);
+
+/**
+ * @brief Clears all histograms.
+ */
+void laser_tag_profiler_reset(void);
@@ -0,0 +1,91 @@
+#include "laser_tag_raw_decoder.h"
+
+#define NEC_BITS 32
+
+// Leader is a 9 ms mark and a 4.5 ms space; AGC eats into the mark at range.
+#define NEC_LEADER_MARK_MIN_US  4000
+#define NEC_LEADER_MARK_MAX_US  12000
+#define NEC_LEADER_SPACE_MIN_US 3000
+#define NEC_LEADER_SPACE_MAX_US 6000
+
+// Bit periods are 1125 us (0) and 2250 us (1), looked up in 128 us buckets.
+#define PERIOD_SHIFT   7
+#define PERIOD_BUCKETS 32
+
+// More erasures than this and a frame is noise that happens to be self-consistent.
+#define MAX_ERASURES 8
+
+typedef enum {
+    BitZero = 0,
+    BitOne = 1,
+    BitErased = 2,
+} Bit;
+
+// Buckets 5..12 (640-1663 us) are a zero, 13..22 (1664-2943 us) a one, the rest erased.
+static const uint8_t period_table[PERIOD_BUCKETS] = {
+    BitErased, BitErased, BitErased, BitErased, BitErased, BitZero,   BitZero,   BitZero,
+    BitZero,   BitZero,   BitZero,   BitZero,   BitZero,   BitOne,    BitOne,    BitOne,
+    BitOne,    BitOne,    BitOne,    BitOne,    BitOne,    BitOne,    BitOne,    BitErased,
+    BitErased, BitErased, BitErased, BitErased, BitErased, BitErased, BitErased, BitErased,
+};
+
+static inline uint8_t classify(uint32_t period) {
+    uint32_t bucket = period >> PERIOD_SHIFT;
+    return period_table[bucket < PERIOD_BUCKETS ? bucket : PERIOD_BUCKETS - 1];
+}
+
+// Rebuilds one byte and its inverse from the 16 bits that carry them.
+static bool resolve_pair(const uint8_t* bits, uint8_t* value, uint8_t* erasures) {
+    uint8_t byte = 0;
+    for(uint8_t i = 0; i < 8; i++) {
+        uint8_t plain = bits[i];
+        uint8_t inverse = bits[i + 8];
+        if(plain == BitErased && inverse == BitErased) return false;
+        if(plain == BitErased) {
+            plain = inverse ^ 1;
+            (*erasures)++;
+        } else if(inverse == BitErased) {
+            (*erasures)++;
+        } else if(plain == inverse) {
+            return false;
+        }
+        byte |= plain << i;
+    }
+    *value = byte;
+    return true;
+}
+
+static bool decode_at(const uint32_t* timings, size_t count, LaserTagRawFrame* frame) {
+    uint8_t bits[NEC_BITS];
+    size_t bit = 0;
+
+    // Data starts after the leader; bits cut off at the end of the capture stay erased.
+    for(size_t i = 2; bit < NEC_BITS; bit++, i += 2) {
+        if(i + 1 < count) {
+            bits[bit] = classify(timings[i] + timings[i + 1]);
+        } else {
+            bits[bit] = BitErased;
+        }
+    }
+
+    uint8_t erasures = 0;
+    // NEC is LSB first: address, ~address, command, ~command.
+    if(!resolve_pair(&bits[0], &frame->address, &erasures)) return false;
+    if(!resolve_pair(&bits[16], &frame->command, &erasures)) return false;
+    if(erasures > MAX_ERASURES) return false;
+
+    frame->erasures = erasures;
+    return true;
+}
+
+bool laser_tag_raw_decoder_decode(const uint32_t* timings, size_t count, LaserTagRawFrame* frame) {
+    // A capture can hold a partial frame followed by a good one, so try every leader.
+    for(size_t i = 0; i + 1 < count; i += 2) {
+        if(timings[i] < NEC_LEADER_MARK_MIN_US || timings[i] > NEC_LEADER_MARK_MAX_US) continue;
+        if(timings[i + 1] < NEC_LEADER_SPACE_MIN_US || timings[i + 1] > NEC_LEADER_SPACE_MAX_US) {
+            continue;
+        }
+        if(decode_at(&timings[i], count - i, frame)) return true;
+    }
+    return false;
+}
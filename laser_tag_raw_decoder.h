@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+* @file laser_tag_raw_decoder.h
+* @brief Tolerant NEC decoder that works on the worker's raw mark/space timings.
+* @details The stock decoder wants every pulse inside a tight window. At range or in sunlight the
+* receiver's AGC clips the leader, stretches marks, or loses the tail of the frame, and once
+* anything is out of bounds the whole frame is dropped. This decoder is more lenient in three
+* ways:
+*   - Bits are classified by their mark+space period through a lookup table, which does not care
+*     how the receiver split the period between mark and space.
+*   - A period that fits neither bit is an erasure, not an error.
+*   - NEC sends address and command each followed by its inverse. Every erased or clipped bit can
+*     therefore be rebuilt from its twin, and every pair of bits received twice is cross-checked.
+*
+* A frame is only accepted once all 32 bits are known and consistent, so the extra reach does not
+* come at the cost of false hits. Plain C with no firmware dependencies, so it builds on a host.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    uint8_t address;
+    uint8_t command;
+    uint8_t erasures; /**< Bits that had to be rebuilt from their inverse. */
+} LaserTagRawFrame;
+
+/**
+ * @brief Decodes the first valid NEC frame in a raw capture.
+ * @param timings Alternating mark/space durations in microseconds, starting with a mark.
+ * @param count Number of timings.
+ * @param frame Decoded frame.
+ * @return true if a frame was recovered.
+ */
+bool laser_tag_raw_decoder_decode(const uint32_t* timings, size_t count, LaserTagRawFrame* frame);
@@ -1,4 +1,5 @@
 #include "laser_tag_view.h"
+#include "laser_tag_arena.h"
 #include <furi.h>
 #include <gui/elements.h>
 
@@ -6,45 +7,67 @@ struct LaserTagView {
     View* view;
 };
 
+#define LASER_TAG_VIEW_BAR_WIDTH 58
+
 typedef struct {
     uint8_t health;
+    uint8_t shield;
     uint16_t ammo;
     uint32_t game_time;
     bool game_over;
+    bool scanning;
+    bool reloading;
+    const char* weapon; /**< Static weapon name, NULL until one is selected. */
+    // Derived widget state, recomputed only when the field behind it changes.
+    uint8_t health_width;
+    uint8_t ammo_width;
+    char time_text[12];
+    char shield_text[12];
 } LaserTagViewModel;
 
+static uint8_t laser_tag_view_bar_width(uint32_t value) {
+    uint32_t width = (LASER_TAG_VIEW_BAR_WIDTH * value) / 100;
+    return width > LASER_TAG_VIEW_BAR_WIDTH ? LASER_TAG_VIEW_BAR_WIDTH : width;
+}
+
 static void laser_tag_view_draw_callback(Canvas* canvas, void* model) {
     LaserTagViewModel* m = model;
     furi_assert(m);
     furi_assert(canvas);
 
-    canvas_clear(canvas);
+    // The GUI hands every frame over as a cleared canvas, so all widgets are
+    // drawn; everything that needs computing has been done in update already.
     canvas_set_color(canvas, ColorBlack);
 
     canvas_draw_str_aligned(canvas, 5, 10, AlignLeft, AlignBottom, "Solo");
+    if(m->shield > 0) {
+        canvas_draw_str_aligned(canvas, 115, 10, AlignRight, AlignBottom, m->shield_text);
+    }
 
     canvas_draw_str_aligned(canvas, 5, 25, AlignLeft, AlignBottom, "Health:");
     canvas_draw_frame(canvas, 55, 20, 60, 10);
-    canvas_draw_box(canvas, 56, 21, (58 * m->health) / 100, 8);
+    canvas_draw_box(canvas, 56, 21, m->health_width, 8);
 
     canvas_draw_str_aligned(canvas, 5, 40, AlignLeft, AlignBottom, "Ammo:");
     canvas_draw_frame(canvas, 55, 35, 60, 10);
-    canvas_draw_box(canvas, 56, 36, (58 * m->ammo) / 100, 8);
+    canvas_draw_box(canvas, 56, 36, m->ammo_width, 8);
 
-    if(m->ammo == 0) {
+    if(m->scanning) {
+        canvas_draw_str_aligned(canvas, 5, 55, AlignLeft, AlignBottom, "Scanning for tag...");
+    } else if(m->reloading) {
+        canvas_draw_str_aligned(canvas, 5, 55, AlignLeft, AlignBottom, "Reloading...");
+    } else if(m->ammo == 0) {
         canvas_draw_str_aligned(canvas, 5, 55, AlignLeft, AlignBottom, "Press 'Down' to Reload");
     }
 
-    uint32_t minutes = m->game_time / 60;
-    uint32_t seconds = m->game_time % 60;
-    FuriString* str = furi_string_alloc_printf("%02ld:%02ld", minutes, seconds);
-    canvas_draw_str_aligned(canvas, 5, 60, AlignLeft, AlignBottom, furi_string_get_cstr(str));
+    canvas_draw_str_aligned(canvas, 5, 60, AlignLeft, AlignBottom, m->time_text);
+    if(m->weapon) {
+        canvas_draw_str_aligned(canvas, 115, 60, AlignRight, AlignBottom, m->weapon);
+    }
 
     if(m->game_over) {
         canvas_draw_str_aligned(canvas, 5, 75, AlignLeft, AlignBottom, "GAME OVER");
     }
-
-    furi_string_free(str);
 }
 
 static bool laser_tag_view_input_callback(InputEvent* event, void* context) {
@@ -54,19 +77,26 @@ static bool laser_tag_view_input_callback(InputEvent* event, void* context) {
 }
 
 LaserTagView* laser_tag_view_alloc() {
-    LaserTagView* laser_tag_view = malloc(sizeof(LaserTagView));
+    LaserTagView* laser_tag_view = laser_tag_arena_alloc(sizeof(LaserTagView));
     if(!laser_tag_view) {
         return NULL;
     }
 
     laser_tag_view->view = view_alloc();
     if(!laser_tag_view->view) {
-        free(laser_tag_view);
         return NULL;
     }
 
     view_set_context(laser_tag_view->view, laser_tag_view);
     view_allocate_model(laser_tag_view->view, ViewModelTypeLocking, sizeof(LaserTagViewModel));
+    with_view_model(
+        laser_tag_view->view,
+        LaserTagViewModel * model,
+        {
+            memset(model, 0, sizeof(LaserTagViewModel));
+            strlcpy(model->time_text, "00:00", sizeof(model->time_text));
+        },
+        false);
     view_set_draw_callback(laser_tag_view->view, laser_tag_view_draw_callback);
     view_set_input_callback(laser_tag_view->view, laser_tag_view_input_callback);
 
@@ -77,8 +107,8 @@ void laser_tag_view_free(LaserTagView* laser_tag_view) {
     if(!laser_tag_view) return;
     if(laser_tag_view->view) {
         view_free(laser_tag_view->view);
+        laser_tag_view->view = NULL;
     }
-    free(laser_tag_view);
 }
 
 void laser_tag_view_draw(View* view, Canvas* canvas) {
@@ -94,18 +124,67 @@ View* laser_tag_view_get_view(LaserTagView* laser_tag_view) {
     return laser_tag_view->view;
 }
 
-void laser_tag_view_update(LaserTagView* laser_tag_view, GameState* game_state) {
+uint32_t laser_tag_view_update(LaserTagView* laser_tag_view, GameState* game_state) {
     furi_assert(laser_tag_view);
     furi_assert(game_state);
 
+    uint8_t health = game_state_get_health(game_state);
+    uint8_t shield = game_state_get_shield(game_state);
+    uint16_t ammo = game_state_get_ammo(game_state);
+    uint32_t game_time = game_state_get_time(game_state);
+    bool game_over = game_state_is_game_over(game_state);
+
+    uint32_t changed = 0;
+    LaserTagViewModel* model = view_get_model(laser_tag_view->view);
+    if(model->health != health) {
+        model->health = health;
+        model->health_width = laser_tag_view_bar_width(health);
+        changed |= LaserTagViewFieldHealth;
+    }
+    if(model->shield != shield) {
+        model->shield = shield;
+        snprintf(model->shield_text, sizeof(model->shield_text), "Shield %u", shield);
+        changed |= LaserTagViewFieldShield;
+    }
+    if(model->ammo != ammo) {
+        model->ammo = ammo;
+        model->ammo_width = laser_tag_view_bar_width(ammo);
+        changed |= LaserTagViewFieldAmmo;
+    }
+    if(model->game_time != game_time) {
+        model->game_time = game_time;
+        snprintf(
+            model->time_text,
+            sizeof(model->time_text),
+            "%02lu:%02lu",
+            game_time / 60,
+            game_time % 60);
+        changed |= LaserTagViewFieldTime;
+    }
+    if(model->game_over != game_over) {
+        model->game_over = game_over;
+        changed |= LaserTagViewFieldGameOver;
+    }
+    // Redraws are driven by the app's frame scheduler, not by the view.
+    view_commit_model(laser_tag_view->view, false);
+
+    return changed;
+}
+
+void laser_tag_view_set_scanning(LaserTagView* laser_tag_view, bool scanning) {
+    furi_assert(laser_tag_view);
     with_view_model(
-        laser_tag_view->view,
-        LaserTagViewModel * model,
-        {
-            model->health = game_state_get_health(game_state);
-            model->ammo = game_state_get_ammo(game_state);
-            model->game_time = game_state_get_time(game_state);
-            model->game_over = game_state_is_game_over(game_state);
-        },
-        true);
+        laser_tag_view->view, LaserTagViewModel * model, { model->scanning = scanning; }, false);
+}
+
+void laser_tag_view_set_reloading(LaserTagView* laser_tag_view, bool reloading) {
+    furi_assert(laser_tag_view);
+    with_view_model(
+        laser_tag_view->view, LaserTagViewModel * model, { model->reloading = reloading; }, false);
+}
+
+void laser_tag_view_set_weapon(LaserTagView* laser_tag_view, const char* name) {
+    furi_assert(laser_tag_view);
+    with_view_model(
+        laser_tag_view->view, LaserTagViewModel * model, { model->weapon = name; }, false);
 }
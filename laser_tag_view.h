@@ -6,8 +6,19 @@
 
 typedef struct LaserTagView LaserTagView;
 
+typedef enum {
+    LaserTagViewFieldHealth = (1 << 0),
+    LaserTagViewFieldAmmo = (1 << 1),
+    LaserTagViewFieldTime = (1 << 2),
+    LaserTagViewFieldGameOver = (1 << 3),
+    LaserTagViewFieldShield = (1 << 4),
+} LaserTagViewField;
+
 LaserTagView* laser_tag_view_alloc();
 void laser_tag_view_free(LaserTagView* laser_tag_view);
 void laser_tag_view_draw(View* view, Canvas* canvas);
 View* laser_tag_view_get_view(LaserTagView* laser_tag_view);
-void laser_tag_view_update(LaserTagView* laser_tag_view, GameState* game_state);
+uint32_t laser_tag_view_update(LaserTagView* laser_tag_view, GameState* game_state);
+void laser_tag_view_set_scanning(LaserTagView* laser_tag_view, bool scanning);
+void laser_tag_view_set_reloading(LaserTagView* laser_tag_view, bool reloading);
+void laser_tag_view_set_weapon(LaserTagView* laser_tag_view, const char* name);
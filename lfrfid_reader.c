@@ -1,22 +1,39 @@
 #include "lfrfid_reader.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
 #include <lfrfid/protocols/lfrfid_protocols.h>
 #include <toolbox/protocols/protocol_dict.h>
 #include <lib/lfrfid/lfrfid_worker.h>
 
 #define TAG "LfRfid_Reader"
 
+// The LF worker polls its stop flag between capture batches; give it that long
+// to release the antenna before reporting the reader as parked.
+#define LFRFID_READER_PARK_SETTLE_MS 10
+
+// Large enough for every protocol in lfrfid_protocols, checked at alloc time.
+#define LFRFID_READER_DATA_SIZE 32
+
 typedef enum {
     LFRFIDReaderEventTagRead = (1 << 0),
     LFRFIDReaderEventStopThread = (1 << 1),
-    LFRFIDReaderEventAll = (LFRFIDReaderEventTagRead | LFRFIDReaderEventStopThread),
+    LFRFIDReaderEventSync = (1 << 2),
+    LFRFIDReaderEventAll =
+        (LFRFIDReaderEventTagRead | LFRFIDReaderEventStopThread | LFRFIDReaderEventSync),
 } LFRFIDReaderEventType;
 
 struct LFRFIDReader {
-    char* requested_protocol;
+    ProtocolId requested_protocols[LFRFID_READER_MAX_PROTOCOLS];
+    uint8_t requested_count;
     ProtocolId protocol;
+    uint8_t data[LFRFID_READER_DATA_SIZE];
     ProtocolDict* dict;
     LFRFIDWorker* worker;
     FuriThread* thread;
+    FuriSemaphore* parked;
+    volatile bool active;
+    uint32_t park_request; /**< Bumped by every park, written by the caller only. */
+    uint32_t park_served; /**< Last park request answered, reader thread only. */
     LFRFIDReaderTagCallback callback;
     void* callback_context;
 };
@@ -30,88 +47,157 @@ static void lfrfid_cli_read_callback(LFRFIDWorkerReadResult result, ProtocolId p
     }
 }
 
+static void lfrfid_reader_read_start(LFRFIDReader* reader) {
+    reader->protocol = PROTOCOL_NO;
+    lfrfid_worker_read_start(
+        reader->worker, LFRFIDWorkerReadTypeASKOnly, lfrfid_cli_read_callback, reader);
+}
+
+static void lfrfid_reader_deliver_tag(LFRFIDReader* reader) {
+    if(reader->protocol == PROTOCOL_NO) return;
+
+    // Runs for every read, so keep it to id compares and a copy into our own buffer.
+    uint8_t index = 0;
+    while(index < reader->requested_count &&
+          reader->requested_protocols[index] != reader->protocol) {
+        index++;
+    }
+    if(index == reader->requested_count) {
+        FURI_LOG_W(
+            TAG, "Unsupported tag %s", protocol_dict_get_name(reader->dict, reader->protocol));
+        return;
+    }
+
+    size_t size = protocol_dict_get_data_size(reader->dict, reader->protocol);
+    protocol_dict_get_data(reader->dict, reader->protocol, reader->data, size);
+    if(reader->callback) {
+        LASER_TAG_LOG_D(TAG, "Tag detected, %zu bytes", size);
+        reader->callback(index, reader->data, size, reader->callback_context);
+    } else {
+        FURI_LOG_W(TAG, "No callback set for detected tag");
+    }
+}
+
+static int32_t lfrfid_reader_thread(void* ctx) {
+    LFRFIDReader* reader = (LFRFIDReader*)ctx;
+    bool reading = false;
+
+    while(true) {
+        uint32_t flags =
+            furi_thread_flags_wait(LFRFIDReaderEventAll, FuriFlagWaitAny, FuriWaitForever);
+        if(flags & FuriFlagError) continue;
+        if(flags & LFRFIDReaderEventStopThread) break;
+
+        if((flags & LFRFIDReaderEventTagRead) && reading) {
+            lfrfid_reader_deliver_tag(reader);
+            lfrfid_reader_read_start(reader);
+        }
+
+        if(flags & LFRFIDReaderEventSync) {
+            // Reconcile with the most recent park/unpark request. The request is read before
+            // the state it was made with, so a park counted here is one whose state we see.
+            uint32_t park_request = __atomic_load_n(&reader->park_request, __ATOMIC_ACQUIRE);
+            if(reader->active && !reading) {
+                lfrfid_reader_read_start(reader);
+                reading = true;
+            } else if(!reader->active) {
+                if(reading) {
+                    lfrfid_worker_stop(reader->worker);
+                    furi_delay_ms(LFRFID_READER_PARK_SETTLE_MS);
+                    reading = false;
+                }
+                // Several Syncs can be handled while parked, e.g. after a quick unpark and
+                // park; only answer each park once, or the next one would return early.
+                if(park_request != reader->park_served) {
+                    reader->park_served = park_request;
+                    furi_semaphore_release(reader->parked);
+                }
+            }
+        }
+    }
+
+    if(reading) {
+        lfrfid_worker_stop(reader->worker);
+    }
+    LASER_TAG_LOG_D(TAG, "LfRfidReader thread exiting");
+    return 0;
+}
+
 LFRFIDReader* lfrfid_reader_alloc() {
-    LFRFIDReader* reader = malloc(sizeof(LFRFIDReader));
+    LFRFIDReader* reader = laser_tag_arena_alloc(sizeof(LFRFIDReader));
+    if(!reader) return NULL;
+    reader->requested_count = 0;
+    reader->callback = NULL;
+    reader->callback_context = NULL;
     reader->protocol = PROTOCOL_NO;
+    reader->active = false;
+    reader->park_request = 0;
+    reader->park_served = 0;
     reader->dict = protocol_dict_alloc(lfrfid_protocols, LFRFIDProtocolMax);
+    furi_check(protocol_dict_get_max_data_size(reader->dict) <= LFRFID_READER_DATA_SIZE);
     reader->worker = lfrfid_worker_alloc(reader->dict);
+    reader->parked = furi_semaphore_alloc(1, 0);
+
+    // Both threads live as long as the reader; scans only switch the worker mode.
+    lfrfid_worker_start_thread(reader->worker);
+    reader->thread = furi_thread_alloc_ex("lfrfid_reader", 2048, lfrfid_reader_thread, reader);
+    furi_thread_start(reader->thread);
 
     return reader;
 }
 
+uint8_t lfrfid_reader_add_protocol(LFRFIDReader* reader, const char* protocol_name) {
+    furi_assert(reader);
+    furi_assert(protocol_name);
+
+    ProtocolId protocol = protocol_dict_get_protocol_by_name(reader->dict, protocol_name);
+    if(protocol == PROTOCOL_NO) {
+        FURI_LOG_E(TAG, "Unknown protocol %s", protocol_name);
+        return LFRFID_READER_PROTOCOL_NONE;
+    }
+    if(reader->requested_count == LFRFID_READER_MAX_PROTOCOLS) {
+        FURI_LOG_E(TAG, "Too many protocols, dropping %s", protocol_name);
+        return LFRFID_READER_PROTOCOL_NONE;
+    }
+
+    // Scans run in short ASK-only windows; a PSK tag would never be decoded in time.
+    if(!(protocol_dict_get_features(reader->dict, protocol) & LFRFIDFeatureASK)) {
+        FURI_LOG_E(TAG, "Protocol %s is not ASK, dropping it", protocol_name);
+        return LFRFID_READER_PROTOCOL_NONE;
+    }
+    reader->requested_protocols[reader->requested_count] = protocol;
+    return reader->requested_count++;
+}
+
 void lfrfid_reader_set_tag_callback(
     LFRFIDReader* reader,
-    char* requested_protocol,
     LFRFIDReaderTagCallback callback,
     void* context) {
     furi_assert(reader);
-    furi_assert(requested_protocol);
-    reader->requested_protocol = requested_protocol;
     reader->callback = callback;
     reader->callback_context = context;
 }
 
-static int32_t lfrfid_reader_start_thread(void* ctx) {
-    LFRFIDReader* reader = (LFRFIDReader*)ctx;
-    furi_thread_flags_clear(LFRFIDReaderEventAll);
-    lfrfid_worker_start_thread(reader->worker);
-    lfrfid_worker_read_start(
-        reader->worker, LFRFIDWorkerReadTypeASKOnly, lfrfid_cli_read_callback, reader);
-    while(true) {
-        uint32_t flags = furi_thread_flags_wait(LFRFIDReaderEventAll, FuriFlagWaitAny, 100);
-
-        if(flags != (unsigned)FuriFlagErrorTimeout) {
-            if((flags & LFRFIDReaderEventTagRead) == LFRFIDReaderEventTagRead) {
-                furi_thread_flags_clear(LFRFIDReaderEventTagRead);
-                if(reader->protocol != PROTOCOL_NO) {
-                    const char* protocol_name =
-                        protocol_dict_get_name(reader->dict, reader->protocol);
-                    if(strcmp(protocol_name, reader->requested_protocol) == 0) {
-                        size_t size = protocol_dict_get_data_size(reader->dict, reader->protocol);
-                        uint8_t* data = malloc(size);
-                        protocol_dict_get_data(reader->dict, reader->protocol, data, size);
-                        if(reader->callback) {
-                            FURI_LOG_D(TAG, "Tag %s detected", protocol_name);
-                            reader->callback(data, size, reader->callback_context);
-                        } else {
-                            FURI_LOG_W(TAG, "No callback set for tag %s", protocol_name);
-                        }
-                        free(data);
-                    } else {
-                        FURI_LOG_W(TAG, "Unsupported tag %s, expected EM4100", protocol_name);
-                    }
-                }
-                reader->protocol = PROTOCOL_NO;
-                lfrfid_worker_read_start(
-                    reader->worker, LFRFIDWorkerReadTypeASKOnly, lfrfid_cli_read_callback, reader);
-            } else if((flags & LFRFIDReaderEventStopThread) == LFRFIDReaderEventStopThread) {
-                break;
-            }
-        }
-    }
-    lfrfid_worker_stop(reader->worker);
-    lfrfid_worker_stop_thread(reader->worker);
-    FURI_LOG_D(TAG, "LfRfidReader thread exiting");
-    return 0;
-}
-
-void lfrfid_reader_start(LFRFIDReader* reader) {
-    reader->thread =
-        furi_thread_alloc_ex("lfrfid_reader", 2048, lfrfid_reader_start_thread, reader);
-    furi_thread_start(reader->thread);
+void lfrfid_reader_unpark(LFRFIDReader* reader) {
+    furi_assert(reader);
+    reader->active = true;
+    furi_thread_flags_set(furi_thread_get_id(reader->thread), LFRFIDReaderEventSync);
 }
 
-void lfrfid_reader_stop(LFRFIDReader* reader) {
-    if(reader->thread) {
-        furi_thread_flags_set(furi_thread_get_id(reader->thread), LFRFIDReaderEventStopThread);
-        furi_thread_join(reader->thread);
-        reader->thread = NULL;
-    }
+void lfrfid_reader_park(LFRFIDReader* reader) {
+    furi_assert(reader);
+    reader->active = false;
+    __atomic_add_fetch(&reader->park_request, 1, __ATOMIC_RELEASE);
+    furi_thread_flags_set(furi_thread_get_id(reader->thread), LFRFIDReaderEventSync);
+    furi_check(furi_semaphore_acquire(reader->parked, FuriWaitForever) == FuriStatusOk);
 }
 
 void lfrfid_reader_free(LFRFIDReader* reader) {
-    lfrfid_reader_stop(reader);
+    furi_thread_flags_set(furi_thread_get_id(reader->thread), LFRFIDReaderEventStopThread);
+    furi_thread_join(reader->thread);
+    furi_thread_free(reader->thread);
+    lfrfid_worker_stop_thread(reader->worker);
+    furi_semaphore_free(reader->parked);
     protocol_dict_free(reader->dict);
     lfrfid_worker_free(reader->worker);
-    free(reader);
 }
@@ -2,8 +2,8 @@
 
 /**
 * @file lfrfid_reader.h
-* @brief EM4100 tag reader, inspired by applications/main/lfrfid/lfrfid_cli.c
-* @details This file contains the declaration of the LFRFIDReader structure and its functions. You typically allocate a new LFRFIDReader, set the tag detection callback, start the reader. The tag detection callback is called each time a tag is detected. Once you are done, you stop the reader and free it.
+* @brief LF tag reader, inspired by applications/main/lfrfid/lfrfid_cli.c
+* @details This file contains the declaration of the LFRFIDReader structure and its functions. You typically allocate a new LFRFIDReader, add the protocols you care about, set the tag detection callback, then unpark the reader whenever you want to scan. The tag detection callback is called each time a tag is detected. Parking the reader turns the antenna off but keeps its thread and protocol dictionary alive, so the next scan starts right away. Once you are done, you free it.
 * @author CodeAllNight (MrDerekJamison)
 */
 
@@ -11,13 +11,21 @@
 
 typedef struct LFRFIDReader LFRFIDReader;
 
+/** Maximum number of protocols a reader can be asked to report. */
+#define LFRFID_READER_MAX_PROTOCOLS 4
+
+/** Returned by lfrfid_reader_add_protocol() for an unknown or excess protocol. */
+#define LFRFID_READER_PROTOCOL_NONE 0xFF
+
 /**
  * @brief Callback function for tag detection.
- * @param data Tag data.
+ * @param protocol Index returned by lfrfid_reader_add_protocol() for the tag's protocol.
+ * @param data Tag data, owned by the reader and only valid for the duration of the call.
  * @param length Tag data length.
  * @param context Callback context.
  */
-typedef void (*LFRFIDReaderTagCallback)(uint8_t* data, uint8_t length, void* context);
+typedef void (
+    *LFRFIDReaderTagCallback)(uint8_t protocol, uint8_t* data, uint8_t length, void* context);
 
 /**
  * @brief Allocates a new LFRFIDReader.
@@ -25,30 +33,40 @@ typedef void (*LFRFIDReaderTagCallback)(uint8_t* data, uint8_t length, void* con
  */
 LFRFIDReader* lfrfid_reader_alloc();
 
+/**
+ * @brief Adds a protocol to report. Tags of any other protocol are ignored.
+ * @details The name is looked up once, here, so tag delivery only compares protocol ids.
+ * @param reader LFRFIDReader to add the protocol to.
+ * @param protocol_name Protocol name, e.g. "EM4100".
+ * @return Index passed to the tag callback, in the order protocols were added, or
+ * LFRFID_READER_PROTOCOL_NONE if the protocol is unknown or the table is full.
+ */
+uint8_t lfrfid_reader_add_protocol(LFRFIDReader* reader, const char* protocol_name);
+
 /**
  * @brief Sets the tag detection callback.
  * @param reader LFRFIDReader to set the callback for.
- * @param requested_protocol Requested protocol, e.g. "EM4100".
  * @param callback Callback function.
  * @param context Callback context.
  */
 void lfrfid_reader_set_tag_callback(
     LFRFIDReader* reader,
-    char* requested_protocol,
     LFRFIDReaderTagCallback callback,
     void* context);
 
 /**
- * @brief Starts the LFRFIDReader.
- * @param reader LFRFIDReader to start.
+ * @brief Starts reading tags. Returns immediately.
+ * @param reader LFRFIDReader to unpark.
  */
-void lfrfid_reader_start(LFRFIDReader* reader);
+void lfrfid_reader_unpark(LFRFIDReader* reader);
 
 /**
- * @brief Stops the LFRFIDReader.
- * @param reader LFRFIDReader to stop.
+ * @brief Stops reading tags and turns the antenna off.
+ * @details Blocks until the LF worker has been told to release the antenna, so the shared
+ * timers can be handed back to IR as soon as this returns.
+ * @param reader LFRFIDReader to park.
  */
-void lfrfid_reader_stop(LFRFIDReader* reader);
+void lfrfid_reader_park(LFRFIDReader* reader);
 
 /**
  * @brief Frees the LFRFIDReader.
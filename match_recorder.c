@@ -0,0 +1,285 @@
+#include "match_recorder.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+#include <furi_hal_rtc.h>
+#include <furi_hal_version.h>
+#include <storage/storage.h>
+#include <string.h>
+
+#define TAG "MatchRecorder"
+
+#define MATCH_RECORDER_STACK_SIZE 2048
+
+typedef enum {
+    MatchRecorderEventBlock = (1 << 0),
+    MatchRecorderEventClose = (1 << 1),
+    MatchRecorderEventExit = (1 << 2),
+    MatchRecorderEventAll =
+        (MatchRecorderEventBlock | MatchRecorderEventClose | MatchRecorderEventExit),
+} MatchRecorderEvent;
+
+typedef struct {
+    MatchRecord records[MATCH_LOG_RECORDS_PER_BLOCK];
+    uint32_t count;
+    uint32_t full; /**< Set by the game loop to hand the block over, cleared by the writer. */
+    bool opens; /**< First block of a round: the writer opens a new file for it. */
+    uint8_t player_id;
+    uint8_t team_id;
+    uint16_t match_id;
+    uint32_t start_tick;
+    DateTime started;
+} MatchRecorderBlock;
+
+struct MatchRecorder {
+    MatchRecorderBlock blocks[2];
+    uint8_t active; /**< Block the game loop appends to. */
+    bool recording;
+    uint32_t dropped; /**< Written by the game loop, read by the writer once a round closes. */
+    uint32_t closing; /**< Set by the game loop at round end, cleared once the file is done. */
+    FuriThread* thread;
+};
+
+typedef struct {
+    Storage* storage;
+    File* file;
+    bool open;
+    MatchLogHeader header;
+} MatchRecorderWriter;
+
+static void
+    match_recorder_writer_open(MatchRecorderWriter* writer, const MatchRecorderBlock* block) {
+    char path[64];
+    const DateTime* started = &block->started;
+    snprintf(
+        path,
+        sizeof(path),
+        APP_DATA_PATH("match_P%02u_%04u%02u%02u_%02u%02u%02u.ltm"),
+        block->player_id,
+        started->year,
+        started->month,
+        started->day,
+        started->hour,
+        started->minute,
+        started->second);
+
+    MatchLogHeader* header = &writer->header;
+    memset(header, 0, sizeof(MatchLogHeader));
+    memcpy(header->magic, MATCH_LOG_MAGIC, sizeof(header->magic));
+    header->version = MATCH_LOG_VERSION;
+    header->header_size = sizeof(MatchLogHeader);
+    header->record_size = sizeof(MatchRecord);
+    header->block_size = MATCH_LOG_BLOCK_SIZE;
+    header->player_id = block->player_id;
+    header->team_id = block->team_id;
+    header->match_id = block->match_id;
+    memcpy(
+        header->uid,
+        furi_hal_version_uid(),
+        MIN(sizeof(header->uid), furi_hal_version_uid_size()));
+    header->year = started->year;
+    header->month = started->month;
+    header->day = started->day;
+    header->hour = started->hour;
+    header->minute = started->minute;
+    header->second = started->second;
+    header->start_tick = block->start_tick;
+
+    writer->open = storage_file_open(writer->file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+                   storage_file_write(writer->file, header, sizeof(MatchLogHeader)) ==
+                       sizeof(MatchLogHeader);
+    if(writer->open) {
+        LASER_TAG_LOG_I(TAG, "Recording to %s", path);
+    } else {
+        FURI_LOG_W(TAG, "Cannot record to %s, round is not logged", path);
+        storage_file_close(writer->file);
+    }
+}
+
+static void match_recorder_writer_close(MatchRecorderWriter* writer) {
+    // The header is rewritten last, so a non-zero record count means the log is complete.
+    if(storage_file_seek(writer->file, 0, true)) {
+        storage_file_write(writer->file, &writer->header, sizeof(MatchLogHeader));
+    }
+    storage_file_close(writer->file);
+    writer->open = false;
+    LASER_TAG_LOG_I(
+        TAG,
+        "Round logged: %lu records, %lu dropped",
+        writer->header.record_count,
+        writer->header.dropped);
+}
+
+static void match_recorder_writer_take(MatchRecorderWriter* writer, MatchRecorderBlock* block) {
+    if(block->opens) {
+        if(writer->open) match_recorder_writer_close(writer);
+        match_recorder_writer_open(writer, block);
+    }
+
+    if(writer->open && block->count > 0) {
+        // Whole blocks only, so every block stays at a fixed offset in the file.
+        memset(
+            &block->records[block->count],
+            0,
+            sizeof(MatchRecord) * (MATCH_LOG_RECORDS_PER_BLOCK - block->count));
+        if(storage_file_write(writer->file, block->records, MATCH_LOG_BLOCK_SIZE) ==
+           MATCH_LOG_BLOCK_SIZE) {
+            writer->header.record_count += block->count;
+        } else {
+            FURI_LOG_E(TAG, "Write failed, closing the log");
+            match_recorder_writer_close(writer);
+        }
+    }
+}
+
+static int32_t match_recorder_thread(void* context) {
+    MatchRecorder* recorder = context;
+    MatchRecorderWriter writer = {
+        .storage = furi_record_open(RECORD_STORAGE),
+        .open = false,
+    };
+    writer.file = storage_file_alloc(writer.storage);
+    uint8_t next = 0;
+
+    while(true) {
+        uint32_t flags =
+            furi_thread_flags_wait(MatchRecorderEventAll, FuriFlagWaitAny, FuriWaitForever);
+        if(flags & FuriFlagError) continue;
+
+        // Blocks are handed over strictly in turn, so they are taken in the same order.
+        MatchRecorderBlock* block = &recorder->blocks[next];
+        while(__atomic_load_n(&block->full, __ATOMIC_ACQUIRE)) {
+            match_recorder_writer_take(&writer, block);
+            block->count = 0;
+            block->opens = false;
+            __atomic_store_n(&block->full, 0, __ATOMIC_RELEASE);
+            next ^= 1;
+            block = &recorder->blocks[next];
+        }
+
+        // Every block of the round was handed over before the close, so it is all written now.
+        if((flags & MatchRecorderEventClose) &&
+           __atomic_load_n(&recorder->closing, __ATOMIC_ACQUIRE)) {
+            if(writer.open) {
+                writer.header.dropped = recorder->dropped;
+                match_recorder_writer_close(&writer);
+            }
+            __atomic_store_n(&recorder->closing, 0, __ATOMIC_RELEASE);
+        }
+
+        if(flags & MatchRecorderEventExit) break;
+    }
+
+    if(writer.open) match_recorder_writer_close(&writer);
+    storage_file_free(writer.file);
+    furi_record_close(RECORD_STORAGE);
+    LASER_TAG_LOG_D(TAG, "MatchRecorder thread exiting");
+    return 0;
+}
+
+static void match_recorder_submit(MatchRecorder* recorder) {
+    __atomic_store_n(&recorder->blocks[recorder->active].full, 1, __ATOMIC_RELEASE);
+    furi_thread_flags_set(furi_thread_get_id(recorder->thread), MatchRecorderEventBlock);
+    recorder->active ^= 1;
+}
+
+MatchRecorder* match_recorder_alloc() {
+    MatchRecorder* recorder = laser_tag_arena_alloc(sizeof(MatchRecorder));
+    if(!recorder) {
+        FURI_LOG_E(TAG, "Failed to allocate MatchRecorder");
+        return NULL;
+    }
+    recorder->active = 0;
+    recorder->recording = false;
+    recorder->dropped = 0;
+    recorder->closing = 0;
+
+    // Storage may take a while; none of that should ever preempt the game loop or IR.
+    recorder->thread = furi_thread_alloc_ex(
+        "MatchRecorder", MATCH_RECORDER_STACK_SIZE, match_recorder_thread, recorder);
+    furi_thread_set_priority(recorder->thread, FuriThreadPriorityLow);
+    furi_thread_start(recorder->thread);
+    return recorder;
+}
+
+void match_recorder_free(MatchRecorder* recorder) {
+    furi_assert(recorder);
+    match_recorder_stop(recorder);
+    furi_thread_flags_set(furi_thread_get_id(recorder->thread), MatchRecorderEventExit);
+    furi_thread_join(recorder->thread);
+    furi_thread_free(recorder->thread);
+    // Arena memory, released with the app.
+}
+
+void match_recorder_start(
+    MatchRecorder* recorder,
+    uint8_t player_id,
+    uint8_t team_id,
+    uint16_t match_id) {
+    furi_assert(recorder);
+    match_recorder_stop(recorder);
+
+    // Until the writer has closed the last file it may still hold its blocks, and anything
+    // handed over now would end up in that file.
+    if(__atomic_load_n(&recorder->closing, __ATOMIC_ACQUIRE)) {
+        FURI_LOG_W(TAG, "Last round is still being written, round is not logged");
+        return;
+    }
+
+    MatchRecorderBlock* block = &recorder->blocks[recorder->active];
+    furi_assert(!__atomic_load_n(&block->full, __ATOMIC_ACQUIRE));
+    block->opens = true;
+    block->player_id = player_id;
+    block->team_id = team_id;
+    block->match_id = match_id;
+    block->start_tick = furi_get_tick();
+    furi_hal_rtc_get_datetime(&block->started);
+    recorder->dropped = 0;
+    recorder->recording = true;
+}
+
+void match_recorder_stop(MatchRecorder* recorder) {
+    furi_assert(recorder);
+    if(!recorder->recording) return;
+    recorder->recording = false;
+
+    // A block still with the writer took our records already; this one only if it has any.
+    MatchRecorderBlock* block = &recorder->blocks[recorder->active];
+    if(!__atomic_load_n(&block->full, __ATOMIC_ACQUIRE) && (block->count > 0 || block->opens)) {
+        match_recorder_submit(recorder);
+    }
+    __atomic_store_n(&recorder->closing, 1, __ATOMIC_RELEASE);
+    furi_thread_flags_set(furi_thread_get_id(recorder->thread), MatchRecorderEventClose);
+}
+
+void match_recorder_log(
+    MatchRecorder* recorder,
+    GameState* state,
+    MatchRecordType type,
+    uint8_t player_id,
+    uint8_t arg,
+    uint32_t value) {
+    furi_assert(recorder);
+    if(!recorder->recording) return;
+
+    MatchRecorderBlock* block = &recorder->blocks[recorder->active];
+    if(__atomic_load_n(&block->full, __ATOMIC_ACQUIRE)) {
+        // Both blocks are with the writer; losing a record beats stalling a shot.
+        recorder->dropped++;
+        return;
+    }
+
+    MatchRecord* record = &block->records[block->count++];
+    record->tick = furi_get_tick();
+    record->type = type;
+    record->player_id = player_id;
+    record->arg = arg;
+    record->shield = game_state_get_shield(state);
+    record->health = game_state_get_health(state);
+    record->ammo = game_state_get_ammo(state);
+    record->value = value;
+
+    if(block->count == MATCH_LOG_RECORDS_PER_BLOCK) {
+        match_recorder_submit(recorder);
+    }
+}
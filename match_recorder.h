@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+* @file match_recorder.h
+* @brief Binary match log written to the SD card in the background.
+* @details Every shot, hit, confirmation, pickup and state change becomes one 16-byte record.
+* Records land in one of two 512-byte RAM blocks. A full block is handed to a low-priority
+* thread that writes it out whole, so the game loop never waits on storage. When that thread
+* falls behind by more than a block, further records are dropped and counted rather than
+* blocking.
+*
+* Each round is one file, APP_DATA_PATH("match_Pxx_YYYYMMDD_HHMMSS.ltm"). The file is a
+* 512-byte MatchLogHeader followed by whole 512-byte blocks of MatchRecord. The tail of the
+* last block is zero-filled, so readers skip records of type MatchRecordTypeNone. That keeps
+* every block at a fixed offset, and a log can be memory mapped and indexed without parsing.
+* At 16 bytes per record, an hour of busy play is around 100 KB.
+*
+* Rounds started by a referee carry its match id in the header and a MatchRecordTypeSync record
+* for every beacon that set the clock. Each pairs a record tick with the referee's match clock,
+* so logs from every unit in the match merge onto one timeline by interpolating between them.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "game_state.h"
+
+#define MATCH_LOG_MAGIC       "LTML"
+#define MATCH_LOG_VERSION     2
+#define MATCH_LOG_BLOCK_SIZE  512
+#define MATCH_LOG_RECORD_SIZE 16
+#define MATCH_LOG_RECORDS_PER_BLOCK (MATCH_LOG_BLOCK_SIZE / MATCH_LOG_RECORD_SIZE)
+
+typedef enum {
+    MatchRecordTypeNone, /**< Padding at the end of the last block. */
+    MatchRecordTypeState, /**< arg: LaserTagState entered. */
+    MatchRecordTypeShot, /**< We fired. arg: WeaponId. */
+    MatchRecordTypeHit, /**< player: shooter, arg: damage, value: 1 if it hurt. */
+    MatchRecordTypeConfirm, /**< player: victim, arg: 1 on a kill, value: 1 if matched. */
+    MatchRecordTypePickup, /**< player: protocol, arg: TagActionResult, value: last tag bytes. */
+    MatchRecordTypeSync, /**< arg: LaserTagPacketBeacon, value: match clock in ms at tick. */
+} MatchRecordType;
+
+/**
+ * @brief One log entry. Health, shield and ammo are shown values after the event.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t tick; /**< furi_get_tick() when the record was made. */
+    uint8_t type; /**< MatchRecordType. */
+    uint8_t player_id;
+    uint8_t arg;
+    uint8_t shield;
+    uint16_t health;
+    uint16_t ammo;
+    uint32_t value;
+} MatchRecord;
+
+/**
+ * @brief File header, padded to one block. Little endian, like the records.
+ */
+typedef struct __attribute__((packed)) {
+    char magic[4]; /**< MATCH_LOG_MAGIC, not NUL terminated. */
+    uint16_t version;
+    uint16_t header_size; /**< Offset of the first record block. */
+    uint16_t record_size;
+    uint16_t block_size;
+    uint8_t player_id;
+    uint8_t team_id;
+    uint16_t match_id; /**< Referee's match id; 0 for a round started on the unit. */
+    uint8_t uid[8]; /**< MCU UID, tells units apart even when player ids collide. */
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t reserved1;
+    uint32_t start_tick; /**< furi_get_tick() at round start, the base for record ticks. */
+    uint32_t record_count; /**< Written when the round closes; 0 if it never did. */
+    uint32_t dropped; /**< Records lost because storage fell behind. */
+    uint8_t padding[MATCH_LOG_BLOCK_SIZE - 44];
+} MatchLogHeader;
+
+_Static_assert(sizeof(MatchRecord) == MATCH_LOG_RECORD_SIZE, "MatchRecord must be 16 bytes");
+_Static_assert(sizeof(MatchLogHeader) == MATCH_LOG_BLOCK_SIZE, "MatchLogHeader must be a block");
+
+typedef struct MatchRecorder MatchRecorder;
+
+/**
+ * @brief Allocates the recorder and starts its writer thread.
+ * @return MatchRecorder* Pointer to the allocated recorder, or NULL.
+ */
+MatchRecorder* match_recorder_alloc();
+
+/**
+ * @brief Closes any open round and stops the writer thread.
+ * @param recorder MatchRecorder to free.
+ */
+void match_recorder_free(MatchRecorder* recorder);
+
+/**
+ * @brief Starts a new log file, closing the previous round if it is still open.
+ * @details Never waits for the writer. If it has not finished the previous round's file yet,
+ * this round is not logged rather than risk its records landing in that file.
+ * @param recorder MatchRecorder to start.
+ * @param player_id Our player id.
+ * @param team_id Our team id.
+ * @param match_id Referee's match id, or 0.
+ */
+void match_recorder_start(
+    MatchRecorder* recorder,
+    uint8_t player_id,
+    uint8_t team_id,
+    uint16_t match_id);
+
+/**
+ * @brief Hands what is buffered to the writer and asks it to close the round's file.
+ * @param recorder MatchRecorder to stop.
+ */
+void match_recorder_stop(MatchRecorder* recorder);
+
+/**
+ * @brief Appends a record. Never blocks; only call from the game loop.
+ * @param recorder MatchRecorder to append to.
+ * @param state GameState after the event, for the health, shield and ammo columns.
+ * @param type Record type.
+ * @param player_id Other player involved, see MatchRecordType.
+ * @param arg Type specific argument.
+ * @param value Type specific value.
+ */
+void match_recorder_log(
+    MatchRecorder* recorder,
+    GameState* state,
+    MatchRecordType type,
+    uint8_t player_id,
+    uint8_t arg,
+    uint32_t value);
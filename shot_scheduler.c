@@ -0,0 +1,137 @@
+#include "shot_scheduler.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+
+#define TAG "ShotScheduler"
+
+struct ShotScheduler {
+    const WeaponStats* stats;
+    uint8_t weapon;
+    bool held;
+    bool pull_fired; /**< The current pull has had its first shot. */
+    uint8_t owed; /**< Shots still to fire for the current pull. */
+    bool scheduled; /**< next_shot is valid, i.e. something has been fired. */
+    uint32_t next_shot;
+    bool reloading;
+    uint32_t reload_end;
+};
+
+ShotScheduler* shot_scheduler_alloc() {
+    ShotScheduler* scheduler = laser_tag_arena_alloc(sizeof(ShotScheduler));
+    if(!scheduler) {
+        FURI_LOG_E(TAG, "Failed to allocate ShotScheduler");
+        return NULL;
+    }
+    shot_scheduler_set_weapon(scheduler, WeaponIdPistol);
+    shot_scheduler_reset(scheduler);
+    return scheduler;
+}
+
+void shot_scheduler_reset(ShotScheduler* scheduler) {
+    furi_assert(scheduler);
+    shot_scheduler_cancel(scheduler);
+    scheduler->scheduled = false;
+    scheduler->next_shot = 0;
+    scheduler->reloading = false;
+    scheduler->reload_end = 0;
+}
+
+void shot_scheduler_set_weapon(ShotScheduler* scheduler, uint8_t weapon) {
+    furi_assert(scheduler);
+    furi_assert(weapon < WeaponIdCount);
+    scheduler->weapon = weapon;
+    scheduler->stats = weapon_get_stats(weapon);
+    shot_scheduler_cancel(scheduler);
+    LASER_TAG_LOG_I(TAG, "%s selected", scheduler->stats->name);
+}
+
+uint8_t shot_scheduler_get_weapon(const ShotScheduler* scheduler) {
+    furi_assert(scheduler);
+    return scheduler->weapon;
+}
+
+void shot_scheduler_set_trigger(ShotScheduler* scheduler, bool pressed) {
+    furi_assert(scheduler);
+    if(!pressed) {
+        scheduler->held = false;
+        if(scheduler->stats->mode == WeaponModeAuto && scheduler->pull_fired) {
+            scheduler->owed = 0;
+        }
+        return;
+    }
+
+    if(scheduler->reloading || scheduler->owed > 0) return;
+    scheduler->held = true;
+    scheduler->pull_fired = false;
+    scheduler->owed = scheduler->stats->mode == WeaponModeBurst ? scheduler->stats->burst : 1;
+}
+
+void shot_scheduler_cancel(ShotScheduler* scheduler) {
+    furi_assert(scheduler);
+    scheduler->held = false;
+    scheduler->pull_fired = false;
+    scheduler->owed = 0;
+}
+
+bool shot_scheduler_reload(ShotScheduler* scheduler, uint32_t now) {
+    furi_assert(scheduler);
+    if(scheduler->reloading) return false;
+    shot_scheduler_cancel(scheduler);
+    scheduler->reloading = true;
+    scheduler->reload_end = now + furi_ms_to_ticks(scheduler->stats->reload_ms);
+    return true;
+}
+
+bool shot_scheduler_is_reloading(const ShotScheduler* scheduler) {
+    furi_assert(scheduler);
+    return scheduler->reloading;
+}
+
+ShotSchedulerAction
+    shot_scheduler_poll(ShotScheduler* scheduler, uint32_t now, bool tx_busy, uint32_t* wait) {
+    furi_assert(scheduler);
+    furi_assert(wait);
+    *wait = SHOT_SCHEDULER_WAIT_FOREVER;
+
+    if(scheduler->reloading) {
+        int32_t left = (int32_t)(scheduler->reload_end - now);
+        if(left > 0) {
+            *wait = left;
+            return ShotSchedulerActionNone;
+        }
+        scheduler->reloading = false;
+        return ShotSchedulerActionReloaded;
+    }
+
+    if(scheduler->owed == 0) return ShotSchedulerActionNone;
+
+    if(scheduler->scheduled) {
+        int32_t left = (int32_t)(scheduler->next_shot - now);
+        if(left > 0) {
+            *wait = left;
+            return ShotSchedulerActionNone;
+        }
+    }
+
+    // Queueing behind our own frame would only bunch shots up and shift the cadence.
+    if(tx_busy) {
+        *wait = furi_ms_to_ticks(SHOT_SCHEDULER_BUSY_RETRY_MS);
+        return ShotSchedulerActionNone;
+    }
+
+    if(!(scheduler->stats->mode == WeaponModeAuto && scheduler->held)) {
+        scheduler->owed--;
+    }
+    scheduler->pull_fired = true;
+
+    bool mid_burst = scheduler->stats->mode == WeaponModeBurst && scheduler->owed > 0;
+    uint32_t gap = furi_ms_to_ticks(
+        mid_burst ? scheduler->stats->burst_interval_ms : scheduler->stats->interval_ms);
+    // Late by less than a gap is timer latency: keep the cadence. Later than that, start afresh.
+    uint32_t due = now;
+    if(scheduler->scheduled && now - scheduler->next_shot < gap) due = scheduler->next_shot;
+    scheduler->next_shot = due + gap;
+    scheduler->scheduled = true;
+    return ShotSchedulerActionFire;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+* @file shot_scheduler.h
+* @brief Turns trigger presses into shots at the weapon's rate of fire.
+* @details The trigger only records what the player asked for: one shot, a burst, or shots for
+* as long as it is held. shot_scheduler_poll() hands those shots out no faster than the weapon
+* allows and never while our transmitter is still busy. It tells the caller how long to wait
+* before asking again, so one one-shot timer is enough to drive it.
+*
+* Shots are spaced from when the previous one was due, not from when it was polled, so timer
+* latency does not eat into the rate of fire. A held rifle fires exactly interval apart.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "weapon.h"
+
+/** Wait reported by shot_scheduler_poll() when nothing is owed. */
+#define SHOT_SCHEDULER_WAIT_FOREVER UINT32_MAX
+
+/** How soon to ask again when a shot is due but the transmitter is still busy. */
+#define SHOT_SCHEDULER_BUSY_RETRY_MS 10
+
+typedef struct ShotScheduler ShotScheduler;
+
+typedef enum {
+    ShotSchedulerActionNone, /**< Nothing to do before the reported wait. */
+    ShotSchedulerActionFire, /**< Send one shot now. */
+    ShotSchedulerActionReloaded, /**< The reload has finished; refill the ammo. */
+} ShotSchedulerAction;
+
+/**
+ * @brief Allocates a scheduler with the pistol selected.
+ * @return ShotScheduler* Pointer to the allocated scheduler, or NULL.
+ */
+ShotScheduler* shot_scheduler_alloc();
+
+/**
+ * @brief Releases the trigger and cancels any reload, e.g. at the start of a round.
+ * @param scheduler ShotScheduler to reset.
+ */
+void shot_scheduler_reset(ShotScheduler* scheduler);
+
+/**
+ * @brief Selects a weapon. Shots still owed are dropped.
+ * @param scheduler ShotScheduler to update.
+ * @param weapon WeaponId to select.
+ */
+void shot_scheduler_set_weapon(ShotScheduler* scheduler, uint8_t weapon);
+
+/**
+ * @brief Returns the selected weapon.
+ * @param scheduler ShotScheduler to query.
+ * @return Selected WeaponId.
+ */
+uint8_t shot_scheduler_get_weapon(const ShotScheduler* scheduler);
+
+/**
+ * @brief Presses or releases the trigger.
+ * @details A press always owes at least one shot, even if it is released before the shot goes
+ * out. Releasing stops an automatic weapon; a burst always completes. Presses while reloading
+ * or during a burst are ignored.
+ * @param scheduler ShotScheduler to update.
+ * @param pressed true on press, false on release.
+ */
+void shot_scheduler_set_trigger(ShotScheduler* scheduler, bool pressed);
+
+/**
+ * @brief Drops every shot still owed, e.g. when one could not be fired.
+ * @param scheduler ShotScheduler to update.
+ */
+void shot_scheduler_cancel(ShotScheduler* scheduler);
+
+/**
+ * @brief Starts a reload, dropping any shots still owed.
+ * @param scheduler ShotScheduler to update.
+ * @param now Current tick.
+ * @return false if a reload is already in progress.
+ */
+bool shot_scheduler_reload(ShotScheduler* scheduler, uint32_t now);
+
+/**
+ * @brief Tells whether a reload is in progress.
+ * @param scheduler ShotScheduler to query.
+ * @return true while reloading.
+ */
+bool shot_scheduler_is_reloading(const ShotScheduler* scheduler);
+
+/**
+ * @brief Decides what to do now. Call again until it returns ShotSchedulerActionNone.
+ * @param scheduler ShotScheduler to poll.
+ * @param now Current tick.
+ * @param tx_busy true while a previous frame is still queued or on air.
+ * @param wait Set to the ticks until the next poll is useful, or SHOT_SCHEDULER_WAIT_FOREVER.
+ * @return What the caller should do.
+ */
+ShotSchedulerAction
+    shot_scheduler_poll(ShotScheduler* scheduler, uint32_t now, bool tx_busy, uint32_t* wait);
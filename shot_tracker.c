@@ -0,0 +1,99 @@
+#include "shot_tracker.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+
+#define TAG "ShotTracker"
+
+typedef struct {
+    uint32_t tick;
+    bool pending;
+} ShotTrackerShot;
+
+struct ShotTracker {
+    ShotTrackerShot shots[SHOT_TRACKER_IN_FLIGHT];
+    uint8_t next_shot;
+    ShotTrackerStats stats;
+    uint8_t feed[SHOT_TRACKER_FEED_SIZE];
+    uint8_t feed_count;
+    uint8_t feed_head;
+};
+
+ShotTracker* shot_tracker_alloc() {
+    ShotTracker* tracker = laser_tag_arena_alloc(sizeof(ShotTracker));
+    if(!tracker) {
+        FURI_LOG_E(TAG, "Failed to allocate ShotTracker");
+        return NULL;
+    }
+    shot_tracker_reset(tracker);
+    return tracker;
+}
+
+void shot_tracker_reset(ShotTracker* tracker) {
+    furi_assert(tracker);
+    memset(tracker, 0, sizeof(ShotTracker));
+}
+
+void shot_tracker_record_shot(ShotTracker* tracker, uint32_t now) {
+    furi_assert(tracker);
+    ShotTrackerShot* shot = &tracker->shots[tracker->next_shot];
+    tracker->next_shot = (tracker->next_shot + 1) % SHOT_TRACKER_IN_FLIGHT;
+    shot->tick = now;
+    shot->pending = true;
+    tracker->stats.shots++;
+}
+
+bool shot_tracker_match_ack(ShotTracker* tracker, uint32_t now, uint8_t victim_id, bool kill) {
+    furi_assert(tracker);
+    uint32_t window = furi_ms_to_ticks(SHOT_TRACKER_ACK_WINDOW_MS);
+
+    ShotTrackerShot* match = NULL;
+    uint32_t match_age = 0;
+    for(uint8_t i = 0; i < SHOT_TRACKER_IN_FLIGHT; i++) {
+        ShotTrackerShot* shot = &tracker->shots[i];
+        uint32_t age = now - shot->tick;
+        if(shot->pending && age <= window && (!match || age > match_age)) {
+            match = shot;
+            match_age = age;
+        }
+    }
+    if(!match) {
+        LASER_TAG_LOG_D(TAG, "Unmatched ACK from P%02d", victim_id);
+        return false;
+    }
+
+    match->pending = false;
+    tracker->stats.hits++;
+    if(kill) {
+        tracker->stats.kills++;
+        tracker->feed[tracker->feed_head] = victim_id;
+        tracker->feed_head = (tracker->feed_head + 1) % SHOT_TRACKER_FEED_SIZE;
+        if(tracker->feed_count < SHOT_TRACKER_FEED_SIZE) tracker->feed_count++;
+    }
+    LASER_TAG_LOG_I(
+        TAG,
+        "Hit P%02d confirmed after %lu ticks%s",
+        victim_id,
+        (unsigned long)match_age,
+        kill ? ", kill" : "");
+    return true;
+}
+
+const ShotTrackerStats* shot_tracker_get_stats(const ShotTracker* tracker) {
+    furi_assert(tracker);
+    return &tracker->stats;
+}
+
+uint8_t shot_tracker_get_accuracy(const ShotTracker* tracker) {
+    furi_assert(tracker);
+    if(tracker->stats.shots == 0) return 0;
+    return (tracker->stats.hits * 100) / tracker->stats.shots;
+}
+
+int16_t shot_tracker_get_kill(const ShotTracker* tracker, uint8_t index) {
+    furi_assert(tracker);
+    if(index >= tracker->feed_count) return -1;
+    uint8_t slot =
+        (tracker->feed_head + SHOT_TRACKER_FEED_SIZE - 1 - index) % SHOT_TRACKER_FEED_SIZE;
+    return tracker->feed[slot];
+}
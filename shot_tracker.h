@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+* @file shot_tracker.h
+* @brief Matches hit confirmations (ACKs) against our recent shots and keeps round stats.
+* @details Shots carry no sequence number, so an ACK is matched by time. It is credited to the
+* oldest unconfirmed shot fired within SHOT_TRACKER_ACK_WINDOW_MS before it arrived. ACKs that
+* match nothing, e.g. late or duplicate ones, are ignored, which keeps the stats honest.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** In-flight shot table size; older shots are forgotten. */
+#define SHOT_TRACKER_IN_FLIGHT 8
+
+/** Longest time from firing to its ACK: frame, victim processing, ACK backoff and ACK frame. */
+#define SHOT_TRACKER_ACK_WINDOW_MS 250
+
+/** Number of victims remembered for the kill feed. */
+#define SHOT_TRACKER_FEED_SIZE 4
+
+typedef struct ShotTracker ShotTracker;
+
+typedef struct {
+    uint32_t shots;
+    uint32_t hits;
+    uint32_t kills;
+} ShotTrackerStats;
+
+/**
+ * @brief Allocates a tracker with empty stats.
+ * @return ShotTracker* Pointer to the allocated tracker.
+ */
+ShotTracker* shot_tracker_alloc();
+
+/**
+ * @brief Forgets in-flight shots, stats and the kill feed, e.g. at the start of a round.
+ * @param tracker ShotTracker to reset.
+ */
+void shot_tracker_reset(ShotTracker* tracker);
+
+/**
+ * @brief Records a shot that was just fired.
+ * @param tracker ShotTracker to record into.
+ * @param now furi_get_tick() when the shot was fired.
+ */
+void shot_tracker_record_shot(ShotTracker* tracker, uint32_t now);
+
+/**
+ * @brief Credits an ACK to an in-flight shot.
+ * @param tracker ShotTracker to match against.
+ * @param now furi_get_tick() when the ACK was received.
+ * @param victim_id Player that was hit.
+ * @param kill The hit ended the victim's game.
+ * @return true if the ACK matched a shot and was counted.
+ */
+bool shot_tracker_match_ack(ShotTracker* tracker, uint32_t now, uint8_t victim_id, bool kill);
+
+/**
+ * @brief Returns the stats of the current round.
+ * @param tracker ShotTracker to query.
+ * @return Stats, owned by the tracker.
+ */
+const ShotTrackerStats* shot_tracker_get_stats(const ShotTracker* tracker);
+
+/**
+ * @brief Returns accuracy as a whole percentage.
+ * @param tracker ShotTracker to query.
+ * @return hits * 100 / shots, 0 before the first shot.
+ */
+uint8_t shot_tracker_get_accuracy(const ShotTracker* tracker);
+
+/**
+ * @brief Returns a victim from the kill feed, most recent first.
+ * @param tracker ShotTracker to query.
+ * @param index 0 for the latest kill.
+ * @return Victim player id, or -1 if there is no such entry.
+ */
+int16_t shot_tracker_get_kill(const ShotTracker* tracker, uint8_t index);
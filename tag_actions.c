@@ -0,0 +1,207 @@
+#include "tag_actions.h"
+#include "laser_tag_log.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+#include <stdlib.h>
+
+#define TAG "TagActions"
+
+#define TAG_ACTIONS_MAGIC_0 0x13
+#define TAG_ACTIONS_MAGIC_1 0x37
+
+typedef struct {
+    const char* name;
+    uint8_t length;
+    uint8_t magic_length; /**< Leading bytes that must match 13 37. */
+    uint8_t opcode_offset;
+    uint8_t arg_offset;
+} TagActionsProtocol;
+
+static const TagActionsProtocol tag_actions_protocols[] = {
+    {"EM4100", 5, 2, 3, 4},
+    {"H10301", 3, 1, 1, 2},
+};
+
+typedef TagActionResult (*TagActionsHandler)(GameState* state, uint8_t arg);
+
+typedef struct {
+    uint8_t opcode;
+    uint32_t cooldown_ms;
+    TagActionsHandler handler;
+} TagActionsEntry;
+
+typedef struct {
+    uint32_t tag_hash;
+    uint32_t used_at;
+    uint32_t cooldown_ticks;
+    bool used;
+} TagActionsCooldown;
+
+struct TagActions {
+    TagActionsCooldown cooldowns[TAG_ACTIONS_COOLDOWN_SLOTS];
+};
+
+static TagActionResult tag_actions_update(
+    GameState* state,
+    const GameStateUpdate* update,
+    uint32_t fields) {
+    return (game_state_apply(state, update) & fields) ? TagActionResultApplied :
+                                                         TagActionResultNoEffect;
+}
+
+static TagActionResult tag_actions_health(GameState* state, uint8_t arg) {
+    GameStateUpdate update = {.health_gained = arg};
+    return tag_actions_update(state, &update, GameStateFieldHealth);
+}
+
+static TagActionResult tag_actions_shield(GameState* state, uint8_t arg) {
+    GameStateUpdate update = {.shield_gained = arg};
+    return tag_actions_update(state, &update, GameStateFieldShield);
+}
+
+static TagActionResult tag_actions_respawn(GameState* state, uint8_t arg) {
+    UNUSED(arg);
+    uint16_t ammo = game_state_get_ammo(state);
+    GameStateUpdate update = {
+        .health_gained = MAX_HEALTH,
+        .ammo_gained = ammo < INITIAL_AMMO ? INITIAL_AMMO - ammo : 0,
+    };
+    return tag_actions_update(state, &update, GameStateFieldHealth | GameStateFieldAmmo);
+}
+
+static TagActionResult tag_actions_regen(GameState* state, uint8_t arg) {
+    // Lasts for the rest of the round; a weaker pad does not undo a stronger one.
+    GameStateQ8 per_second = (uint32_t)arg * GAME_STATE_Q8_ONE / 10;
+    if(per_second <= game_state_get_regen(state)) return TagActionResultNoEffect;
+    game_state_set_regen(state, per_second);
+    return TagActionResultApplied;
+}
+
+static TagActionResult tag_actions_ammo(GameState* state, uint8_t arg) {
+    uint16_t ammo = game_state_get_ammo(state);
+    uint16_t delta_ammo = ammo < INITIAL_AMMO ? INITIAL_AMMO - ammo : 0;
+    GameStateUpdate update = {.ammo_gained = delta_ammo > arg ? arg : delta_ammo};
+    return tag_actions_update(state, &update, GameStateFieldAmmo);
+}
+
+// Must stay sorted by opcode, it is binary searched.
+static const TagActionsEntry tag_actions_table[] = {
+    {TagActionOpcodeHealth, 10000, tag_actions_health},
+    {TagActionOpcodeShield, 15000, tag_actions_shield},
+    {TagActionOpcodeRespawn, 30000, tag_actions_respawn},
+    {TagActionOpcodeRegen, 30000, tag_actions_regen},
+    {TagActionOpcodeAmmo, 5000, tag_actions_ammo},
+};
+
+static const TagActionsEntry* tag_actions_find(uint8_t opcode) {
+    size_t low = 0;
+    size_t high = COUNT_OF(tag_actions_table);
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+        if(tag_actions_table[mid].opcode < opcode) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if(low < COUNT_OF(tag_actions_table) && tag_actions_table[low].opcode == opcode) {
+        return &tag_actions_table[low];
+    }
+    return NULL;
+}
+
+static uint32_t tag_actions_hash(uint8_t protocol, const uint8_t* data, uint8_t length) {
+    // FNV-1a, same as the player id: cheap and good enough for a handful of pads.
+    uint32_t hash = (2166136261UL ^ protocol) * 16777619UL;
+    for(uint8_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+TagActions* tag_actions_alloc() {
+    TagActions* actions = laser_tag_arena_alloc(sizeof(TagActions));
+    if(!actions) {
+        FURI_LOG_E(TAG, "Failed to allocate TagActions");
+        return NULL;
+    }
+    tag_actions_reset(actions);
+    return actions;
+}
+
+void tag_actions_free(TagActions* actions) {
+    // Arena memory, released with the app.
+    UNUSED(actions);
+}
+
+void tag_actions_reset(TagActions* actions) {
+    furi_assert(actions);
+    memset(actions->cooldowns, 0, sizeof(actions->cooldowns));
+}
+
+size_t tag_actions_get_protocol_count() {
+    return COUNT_OF(tag_actions_protocols);
+}
+
+const char* tag_actions_get_protocol_name(size_t protocol) {
+    furi_assert(protocol < COUNT_OF(tag_actions_protocols));
+    return tag_actions_protocols[protocol].name;
+}
+
+TagActionResult tag_actions_apply(
+    TagActions* actions,
+    GameState* state,
+    uint8_t protocol,
+    const uint8_t* data,
+    uint8_t length,
+    uint32_t now) {
+    furi_assert(actions);
+    furi_assert(state);
+
+    if(protocol >= COUNT_OF(tag_actions_protocols)) return TagActionResultNotGameTag;
+    const TagActionsProtocol* layout = &tag_actions_protocols[protocol];
+    if(length != layout->length) return TagActionResultNotGameTag;
+    if(data[0] != TAG_ACTIONS_MAGIC_0) return TagActionResultNotGameTag;
+    if(layout->magic_length > 1 && data[1] != TAG_ACTIONS_MAGIC_1) {
+        return TagActionResultNotGameTag;
+    }
+
+    uint8_t opcode = data[layout->opcode_offset];
+    const TagActionsEntry* entry = tag_actions_find(opcode);
+    if(!entry) {
+        FURI_LOG_W(TAG, "Tag action unknown: %02x %02x", opcode, data[layout->arg_offset]);
+        return TagActionResultUnknownOpcode;
+    }
+
+    // One cooldown per physical tag; the least recently used slot is recycled.
+    uint32_t hash = tag_actions_hash(protocol, data, length);
+    TagActionsCooldown* slot = &actions->cooldowns[0];
+    for(size_t i = 0; i < TAG_ACTIONS_COOLDOWN_SLOTS; i++) {
+        TagActionsCooldown* cooldown = &actions->cooldowns[i];
+        if(cooldown->used && cooldown->tag_hash == hash) {
+            slot = cooldown;
+            break;
+        }
+        if(!cooldown->used) {
+            slot = cooldown;
+        } else if(slot->used && (int32_t)(cooldown->used_at - slot->used_at) < 0) {
+            slot = cooldown;
+        }
+    }
+    if(slot->used && slot->tag_hash == hash &&
+       (int32_t)(now - slot->used_at) < (int32_t)slot->cooldown_ticks) {
+        LASER_TAG_LOG_D(TAG, "Tag %08lx is cooling down", hash);
+        return TagActionResultCoolingDown;
+    }
+
+    TagActionResult result = entry->handler(state, data[layout->arg_offset]);
+    if(result == TagActionResultApplied) {
+        slot->tag_hash = hash;
+        slot->used_at = now;
+        slot->cooldown_ticks = furi_ms_to_ticks(entry->cooldown_ms);
+        slot->used = true;
+        LASER_TAG_LOG_I(
+            TAG, "Tag %08lx applied opcode %02x arg %d", hash, opcode, data[layout->arg_offset]);
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+* @file tag_actions.h
+* @brief Table-driven dispatcher for RFID pickup tags.
+* @details A game tag carries a magic prefix, an opcode and an argument. Where those bytes live
+* depends on the tag protocol, so every supported protocol has a layout entry. The opcode is then
+* looked up in a table sorted by opcode. Each physical tag gets its own cooldown, so holding a pad
+* against the reader does not farm it.
+*
+*   EM4100 (5 bytes): 13 37 <pad> <opcode> <arg>, the pad byte tells identical pads apart
+*   H10301 (3 bytes): facility code 13, card number <opcode> <arg>
+*
+* Protocols are numbered in table order. Pass that index to tag_actions_apply().
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "game_state.h"
+
+/** Number of recently used tags whose cooldowns are remembered. */
+#define TAG_ACTIONS_COOLDOWN_SLOTS 8
+
+typedef enum {
+    TagActionOpcodeHealth = 0x01, /**< Heal by arg hit points. */
+    TagActionOpcodeShield = 0x02, /**< Add arg shield points. */
+    TagActionOpcodeRespawn = 0x03, /**< Restore full health and ammo. */
+    TagActionOpcodeRegen = 0x04, /**< Regenerate arg tenths of a hit point per second. */
+    TagActionOpcodeAmmo = 0xFD, /**< Refill up to arg rounds. */
+} TagActionOpcode;
+
+typedef enum {
+    TagActionResultApplied, /**< The pickup changed the game state. */
+    TagActionResultNoEffect, /**< Valid pickup, but nothing to top up; no cooldown taken. */
+    TagActionResultCoolingDown, /**< This tag was used too recently. */
+    TagActionResultUnknownOpcode, /**< Game tag with an opcode this build does not know. */
+    TagActionResultNotGameTag, /**< Wrong protocol, length or magic. */
+} TagActionResult;
+
+typedef struct TagActions TagActions;
+
+/**
+ * @brief Allocates a dispatcher with all cooldowns cleared.
+ * @return TagActions* Pointer to the allocated dispatcher.
+ */
+TagActions* tag_actions_alloc();
+
+/**
+ * @brief Frees the dispatcher.
+ * @param actions TagActions to free.
+ */
+void tag_actions_free(TagActions* actions);
+
+/**
+ * @brief Forgets all cooldowns, e.g. at the start of a round.
+ * @param actions TagActions to reset.
+ */
+void tag_actions_reset(TagActions* actions);
+
+/**
+ * @brief Returns the number of supported tag protocols.
+ * @return Protocol count.
+ */
+size_t tag_actions_get_protocol_count();
+
+/**
+ * @brief Returns the ProtocolDict name of a supported protocol.
+ * @param protocol Protocol index, below tag_actions_get_protocol_count().
+ * @return Protocol name, e.g. "EM4100".
+ */
+const char* tag_actions_get_protocol_name(size_t protocol);
+
+/**
+ * @brief Decodes a tag read and applies its action to the game state.
+ * @param actions TagActions holding the cooldowns.
+ * @param state GameState to apply the action to.
+ * @param protocol Protocol index the tag was read with.
+ * @param data Tag data.
+ * @param length Tag data length.
+ * @param now furi_get_tick() at read time.
+ * @return What happened to the read.
+ */
+TagActionResult tag_actions_apply(
+    TagActions* actions,
+    GameState* state,
+    uint8_t protocol,
+    const uint8_t* data,
+    uint8_t length,
+    uint32_t now);
@@ -0,0 +1,157 @@
+#include "timer_wheel.h"
+#include "laser_tag_arena.h"
+#include <furi.h>
+#include <string.h>
+
+#define TAG "TimerWheel"
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_TICK_MASK ((1UL << TIMER_WHEEL_SLOT_SHIFT) - 1)
+#define TIMER_WHEEL_NONE      UINT8_MAX
+
+_Static_assert(
+    (TIMER_WHEEL_SLOTS & TIMER_WHEEL_SLOT_MASK) == 0,
+    "TIMER_WHEEL_SLOTS must be a power of two");
+_Static_assert(TIMER_WHEEL_MAX_TIMERS < TIMER_WHEEL_NONE, "Timer ids must fit a link");
+
+typedef struct {
+    uint32_t deadline;
+    uint8_t next;
+    uint8_t prev;
+    bool pending;
+} TimerWheelTimer;
+
+struct TimerWheel {
+    TimerWheelTimer timers[TIMER_WHEEL_MAX_TIMERS];
+    uint8_t heads[TIMER_WHEEL_SLOTS];
+    uint8_t pending_count;
+    uint32_t cursor; /**< Every deadline before this tick has been expired. */
+    TimerWheelCallback callback;
+    void* callback_context;
+};
+
+static inline uint8_t timer_wheel_slot(uint32_t tick) {
+    return (tick >> TIMER_WHEEL_SLOT_SHIFT) & TIMER_WHEEL_SLOT_MASK;
+}
+
+static void timer_wheel_link(TimerWheel* wheel, uint8_t id) {
+    TimerWheelTimer* timer = &wheel->timers[id];
+    uint8_t* head = &wheel->heads[timer_wheel_slot(timer->deadline)];
+    timer->prev = TIMER_WHEEL_NONE;
+    timer->next = *head;
+    if(*head != TIMER_WHEEL_NONE) wheel->timers[*head].prev = id;
+    *head = id;
+    timer->pending = true;
+    wheel->pending_count++;
+}
+
+static void timer_wheel_unlink(TimerWheel* wheel, uint8_t id) {
+    TimerWheelTimer* timer = &wheel->timers[id];
+    if(timer->prev != TIMER_WHEEL_NONE) {
+        wheel->timers[timer->prev].next = timer->next;
+    } else {
+        wheel->heads[timer_wheel_slot(timer->deadline)] = timer->next;
+    }
+    if(timer->next != TIMER_WHEEL_NONE) wheel->timers[timer->next].prev = timer->prev;
+    timer->pending = false;
+    wheel->pending_count--;
+}
+
+TimerWheel* timer_wheel_alloc(TimerWheelCallback callback, void* context) {
+    furi_assert(callback);
+    TimerWheel* wheel = laser_tag_arena_alloc(sizeof(TimerWheel));
+    if(!wheel) {
+        FURI_LOG_E(TAG, "Failed to allocate TimerWheel");
+        return NULL;
+    }
+    memset(wheel->heads, TIMER_WHEEL_NONE, sizeof(wheel->heads));
+    wheel->pending_count = 0;
+    wheel->cursor = 0;
+    wheel->callback = callback;
+    wheel->callback_context = context;
+    return wheel;
+}
+
+void timer_wheel_schedule(TimerWheel* wheel, uint8_t id, uint32_t now, uint32_t delay) {
+    furi_assert(wheel);
+    furi_assert(id < TIMER_WHEEL_MAX_TIMERS);
+    if(wheel->timers[id].pending) timer_wheel_unlink(wheel, id);
+    // Nothing to expire before now, so the next walk can start here.
+    if(wheel->pending_count == 0) wheel->cursor = now;
+    wheel->timers[id].deadline = now + delay;
+    timer_wheel_link(wheel, id);
+}
+
+void timer_wheel_cancel(TimerWheel* wheel, uint8_t id) {
+    furi_assert(wheel);
+    furi_assert(id < TIMER_WHEEL_MAX_TIMERS);
+    if(wheel->timers[id].pending) timer_wheel_unlink(wheel, id);
+}
+
+bool timer_wheel_is_pending(const TimerWheel* wheel, uint8_t id) {
+    furi_assert(wheel);
+    furi_assert(id < TIMER_WHEEL_MAX_TIMERS);
+    return wheel->timers[id].pending;
+}
+
+size_t timer_wheel_advance(TimerWheel* wheel, uint32_t now) {
+    furi_assert(wheel);
+
+    // Unlink everything first and call back afterwards, so callbacks are free to reschedule.
+    uint8_t expired[TIMER_WHEEL_MAX_TIMERS];
+    size_t count = 0;
+    uint32_t spanned = (now >> TIMER_WHEEL_SLOT_SHIFT) - (wheel->cursor >> TIMER_WHEEL_SLOT_SHIFT);
+    uint32_t slots = spanned < TIMER_WHEEL_SLOTS ? spanned + 1 : TIMER_WHEEL_SLOTS;
+    uint8_t slot = timer_wheel_slot(wheel->cursor);
+    for(uint32_t i = 0; i < slots && wheel->pending_count > 0; i++) {
+        uint8_t id = wheel->heads[slot];
+        while(id != TIMER_WHEEL_NONE) {
+            uint8_t next = wheel->timers[id].next;
+            if((int32_t)(now - wheel->timers[id].deadline) >= 0) {
+                timer_wheel_unlink(wheel, id);
+                expired[count++] = id;
+            }
+            id = next;
+        }
+        slot = (slot + 1) & TIMER_WHEEL_SLOT_MASK;
+    }
+    wheel->cursor = now;
+
+    // Deadline order, so events that were due together still run in the order they were due.
+    for(size_t i = 1; i < count; i++) {
+        uint8_t id = expired[i];
+        size_t j = i;
+        for(; j > 0 && (int32_t)(wheel->timers[expired[j - 1]].deadline -
+                                 wheel->timers[id].deadline) > 0;
+            j--) {
+            expired[j] = expired[j - 1];
+        }
+        expired[j] = id;
+    }
+    for(size_t i = 0; i < count; i++) {
+        wheel->callback(wheel->callback_context, expired[i]);
+    }
+    return count;
+}
+
+uint32_t timer_wheel_get_wait(const TimerWheel* wheel, uint32_t now) {
+    furi_assert(wheel);
+    if(wheel->pending_count == 0) return TIMER_WHEEL_WAIT_FOREVER;
+
+    // Walk from the cursor's slot. Once the earliest deadline found so far lies before
+    // everything the unvisited slots can hold in this rotation, it is the earliest overall.
+    uint32_t earliest = UINT32_MAX;
+    uint8_t slot = timer_wheel_slot(wheel->cursor);
+    uint32_t offset = wheel->cursor & TIMER_WHEEL_TICK_MASK;
+    for(uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        for(uint8_t id = wheel->heads[slot]; id != TIMER_WHEEL_NONE; id = wheel->timers[id].next) {
+            uint32_t remaining = wheel->timers[id].deadline - wheel->cursor;
+            if(remaining < earliest) earliest = remaining;
+        }
+        if(earliest < ((i + 1) << TIMER_WHEEL_SLOT_SHIFT) - offset) break;
+        slot = (slot + 1) & TIMER_WHEEL_SLOT_MASK;
+    }
+
+    uint32_t waited = now - wheel->cursor;
+    return earliest > waited ? earliest - waited : 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/**
+* @file timer_wheel.h
+* @brief Hashed timer wheel for game events, driven by one wakeup at the next deadline.
+* @details Each timer is identified by a small id chosen by the caller and is either pending or
+* not; scheduling a pending id moves it. Timers hang off one of TIMER_WHEEL_SLOTS slots chosen
+* by their deadline, in doubly linked lists, so scheduling and cancelling are O(1). Finding the
+* next deadline walks at most one rotation of slots, and expiring walks only the slots time has
+* passed through. Deadlines further out than one rotation simply wait in their slot for the
+* rotation they belong to.
+*
+* All times are furi ticks and compared with signed differences, so they survive wrap-around.
+* The wheel has no timer of its own: the owner arms a single one-shot timer for
+* timer_wheel_get_wait() and calls timer_wheel_advance() when it fires.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Number of timer ids; ids run from 0 to TIMER_WHEEL_MAX_TIMERS - 1. */
+#define TIMER_WHEEL_MAX_TIMERS 16
+
+/** Slot count and width; one rotation covers SLOTS << SHIFT ticks, about a second. */
+#define TIMER_WHEEL_SLOTS       32
+#define TIMER_WHEEL_SLOT_SHIFT  5
+
+/** Wait reported by timer_wheel_get_wait() when no timer is pending. */
+#define TIMER_WHEEL_WAIT_FOREVER UINT32_MAX
+
+typedef struct TimerWheel TimerWheel;
+
+/**
+ * @brief Called from timer_wheel_advance() for every timer that expired.
+ * @param context Callback context.
+ * @param id Timer id. The callback may schedule any timer again, this one included.
+ */
+typedef void (*TimerWheelCallback)(void* context, uint8_t id);
+
+/**
+ * @brief Allocates an empty wheel.
+ * @param callback Called for every expired timer.
+ * @param context Callback context.
+ * @return TimerWheel* Pointer to the allocated wheel, or NULL.
+ */
+TimerWheel* timer_wheel_alloc(TimerWheelCallback callback, void* context);
+
+/**
+ * @brief Schedules a timer, moving it if it is already pending.
+ * @param wheel TimerWheel to schedule on.
+ * @param id Timer id.
+ * @param now Current tick.
+ * @param delay Ticks from now; 0 expires on the next advance.
+ */
+void timer_wheel_schedule(TimerWheel* wheel, uint8_t id, uint32_t now, uint32_t delay);
+
+/**
+ * @brief Cancels a timer. Does nothing if it is not pending.
+ * @param wheel TimerWheel to update.
+ * @param id Timer id.
+ */
+void timer_wheel_cancel(TimerWheel* wheel, uint8_t id);
+
+/**
+ * @brief Tells whether a timer is pending.
+ * @param wheel TimerWheel to query.
+ * @param id Timer id.
+ * @return true if the timer is scheduled and has not expired yet.
+ */
+bool timer_wheel_is_pending(const TimerWheel* wheel, uint8_t id);
+
+/**
+ * @brief Expires every timer whose deadline has passed, calling back for each.
+ * @param wheel TimerWheel to advance.
+ * @param now Current tick.
+ * @return Number of timers that expired.
+ */
+size_t timer_wheel_advance(TimerWheel* wheel, uint32_t now);
+
+/**
+ * @brief Returns the ticks until the earliest pending deadline.
+ * @param wheel TimerWheel to query.
+ * @param now Current tick.
+ * @return Ticks to wait, 0 if a timer is already due, or TIMER_WHEEL_WAIT_FOREVER.
+ */
+uint32_t timer_wheel_get_wait(const TimerWheel* wheel, uint32_t now);
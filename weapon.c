@@ -0,0 +1,55 @@
+#include "weapon.h"
+#include "laser_tag_packet.h"
+
+_Static_assert(WeaponIdCount <= LASER_TAG_PACKET_MAX_WEAPONS, "Weapon ids must fit the packet");
+
+static const WeaponStats weapon_stats[WeaponIdCount] = {
+    [WeaponIdPistol] =
+        {
+            .name = "Pistol",
+            .mode = WeaponModeSingle,
+            .burst = 1,
+            .interval_ms = 250,
+            .burst_interval_ms = 0,
+            .reload_ms = 1500,
+            .damage_class = 1,
+            .multiplier = GAME_STATE_Q8_ONE,
+        },
+    [WeaponIdRifle] =
+        {
+            .name = "Rifle",
+            .mode = WeaponModeAuto,
+            .burst = 1,
+            .interval_ms = 150,
+            .burst_interval_ms = 0,
+            .reload_ms = 2500,
+            .damage_class = 1,
+            .multiplier = GAME_STATE_Q8_ONE * 3 / 5,
+        },
+    [WeaponIdBurst] =
+        {
+            .name = "Burst",
+            .mode = WeaponModeBurst,
+            .burst = 3,
+            .interval_ms = 500,
+            .burst_interval_ms = 120,
+            .reload_ms = 2000,
+            .damage_class = 1,
+            .multiplier = GAME_STATE_Q8_ONE * 4 / 5,
+        },
+    [WeaponIdSniper] =
+        {
+            .name = "Sniper",
+            .mode = WeaponModeSingle,
+            .burst = 1,
+            .interval_ms = 1500,
+            .burst_interval_ms = 0,
+            .reload_ms = 3000,
+            .damage_class = 1,
+            .multiplier = GAME_STATE_Q8_ONE * 5 / 2,
+        },
+};
+
+const WeaponStats* weapon_get_stats(uint8_t weapon) {
+    return &weapon_stats[weapon < WeaponIdCount ? weapon : WeaponIdPistol];
+}
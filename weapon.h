@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+* @file weapon.h
+* @brief Weapon stats: rate of fire, trigger mode, reload time and damage multiplier.
+* @details A weapon's id travels in the shot packet, so the victim looks up the multiplier for
+* the weapon that actually hit it. Ids without an entry, e.g. the legacy shot's, get the pistol's
+* stats, which leave damage unchanged.
+*
+* Every interval is longer than an NEC frame (about 68 ms) plus the carrier sense window, so a
+* unit never asks for a shot while its previous one is still on air. That caps each player at
+* a known share of the shared IR channel.
+*/
+
+#include <stdint.h>
+#include "game_state.h"
+
+typedef enum {
+    WeaponIdPistol,
+    WeaponIdRifle,
+    WeaponIdBurst,
+    WeaponIdSniper,
+    WeaponIdCount,
+} WeaponId;
+
+typedef enum {
+    WeaponModeSingle, /**< One shot per trigger pull. */
+    WeaponModeBurst, /**< burst shots per trigger pull. */
+    WeaponModeAuto, /**< Fires for as long as the trigger is held. */
+} WeaponMode;
+
+typedef struct {
+    const char* name;
+    WeaponMode mode;
+    uint8_t burst; /**< Shots per pull in burst mode, 1 otherwise. */
+    uint16_t interval_ms; /**< Shortest time between pulls, or between shots in auto mode. */
+    uint16_t burst_interval_ms; /**< Time between the shots of one burst. */
+    uint16_t reload_ms;
+    uint8_t damage_class; /**< Sent in the packet, see laser_tag_packet_get_damage(). */
+    GameStateQ8 multiplier; /**< Applied by the victim to the damage class's damage. */
+} WeaponStats;
+
+/**
+ * @brief Returns a weapon's stats.
+ * @param weapon Weapon id as sent in the packet; unknown ids get the pistol.
+ * @return WeaponStats for the weapon, never NULL.
+ */
+const WeaponStats* weapon_get_stats(uint8_t weapon);